@@ -61,10 +61,11 @@ class Builder : public QObject
 public:
     Builder(QString projectDir, QString strideRoot, QString platformPath)
         : m_projectDir(projectDir), m_strideRoot(strideRoot),
-          m_platformPath(platformPath) {}
+          m_platformPath(platformPath), m_timeout(0) {}
     virtual ~Builder() {}
 
     void setConfiguration(QMap<QString, QVariant> config) { m_configuration = config; }
+    void setTimeout(int msecs) { m_timeout = msecs; } // Abort build or run after msecs. 0 waits forever
     QString getPlatformPath() {return m_platformPath;}
     QString getStdErr() const {return m_stdErr;}
     QString getStdOut() const {return m_stdOut;}
@@ -87,6 +88,7 @@ protected:
     QString m_stdOut;
     QString m_stdErr;
     QMap<QString, QVariant> m_configuration;
+    int m_timeout;
 
 private:
     PluginInterface m_interface;
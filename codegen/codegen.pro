@@ -16,15 +16,20 @@ message(Building $${TARGET})
 
 SOURCES += \
     pythonproject.cpp \
+    pythonworker.cpp \
     codevalidator.cpp \
     coderesolver.cpp \
     stridelibrary.cpp \
     strideplatform.cpp \
     stridesystem.cpp \
+    stridesystemcache.cpp \
+    incrementalresolver.cpp \
+    symbolmanifest.cpp \
     systemconfiguration.cpp
 
 HEADERS += \
     pythonproject.h \
+    pythonworker.h \
     codevalidator.h \
     coderesolver.h \
     builder.h \
@@ -32,6 +37,9 @@ HEADERS += \
     strideplatform.hpp \
     porttypes.h \
     stridesystem.hpp \
+    stridesystemcache.hpp \
+    incrementalresolver.hpp \
+    symbolmanifest.hpp \
     systemconfiguration.hpp
 
 win32-msvc2015:CONFIG(release, debug|release): LIBS += -L$$OUT_PWD/../parser/release/ -lStrideParser
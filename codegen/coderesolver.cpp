@@ -35,12 +35,17 @@
 
 #include <QDebug>
 
+#include <cmath>
+#include <cstdio>
+#include <functional>
+
 #include "coderesolver.h"
 #include "codevalidator.h"
 
 CodeResolver::CodeResolver(std::shared_ptr<StrideSystem> system, ASTNode tree,
-                           SystemConfiguration systemConfig) :
-    m_system(system), m_systemConfig(systemConfig), m_tree(tree), m_connectorCounter(0)
+                           SystemConfiguration systemConfig, bool copyBuiltinObjects) :
+    m_system(system), m_systemConfig(systemConfig), m_tree(tree), m_connectorCounter(0),
+    m_copyBuiltinObjects(copyBuiltinObjects)
 {
 
 }
@@ -495,7 +500,13 @@ void CodeResolver::insertBuiltinObjects()
     QList<std::shared_ptr<DeclarationNode>> requiredDeclarations;
     map<string, vector<ASTNode>> bultinObjects;
     if (m_system) {
-        bultinObjects = m_system->getBuiltinObjectsReference();
+        // Builtin objects are inserted into the tree and modified in place, so
+        // a system shared by several trees must hand out copies.
+        if (m_copyBuiltinObjects) {
+            bultinObjects = m_system->getBuiltinObjectsCopy();
+        } else {
+            bultinObjects = m_system->getBuiltinObjectsReference();
+        }
     }
 
     // First pass to add the fundamental types
@@ -1892,6 +1903,7 @@ void CodeResolver::resolveConstantsInNode(ASTNode node, QVector<ASTNode > scope)
                 }
             }
         }
+        foldPureFunctions(stream, scope);
         resolveConstantsInNode(stream->getRight(), scope);
     } else if (node->getNodeType() == AST::Function) {
         std::shared_ptr<FunctionNode> func = static_pointer_cast<FunctionNode>(node);
@@ -2009,6 +2021,919 @@ void CodeResolver::resolveConstantsInNode(ASTNode node, QVector<ASTNode > scope)
     }
 }
 
+void CodeResolver::foldPureFunctions(std::shared_ptr<StreamNode> stream, QVector<ASTNode > scope)
+{
+    // Replaces constant >> PureFunction() >> ... with the computed value, so
+    // no code is generated for it.
+    while (stream->getRight()->getNodeType() == AST::Stream) {
+        std::shared_ptr<StreamNode> next = static_pointer_cast<StreamNode>(stream->getRight());
+        if (next->getLeft()->getNodeType() != AST::Function) {
+            return;
+        }
+        std::vector<double> inputs, outputs;
+        if (!constantValues(stream->getLeft(), scope, inputs)
+                || !evaluatePureFunction(static_pointer_cast<FunctionNode>(next->getLeft()), inputs, outputs, scope)
+                || outputs.size() != 1) {
+            return;
+        }
+        ASTNode left = stream->getLeft();
+        stream->setLeft(std::make_shared<ValueNode>(outputs[0], left->getFilename().data(), left->getLine()));
+        stream->setRight(next->getRight());
+    }
+}
+
+bool CodeResolver::constantValues(ASTNode node, QVector<ASTNode > scope, std::vector<double> &values)
+{
+    if (node->getNodeType() == AST::List) {
+        for (ASTNode element: node->getChildren()) {
+            if (!constantValues(element, scope, values)) {
+                return false;
+            }
+        }
+        return values.size() > 0;
+    }
+    std::shared_ptr<ValueNode> value;
+    if (node->getNodeType() == AST::Int || node->getNodeType() == AST::Real) {
+        value = static_pointer_cast<ValueNode>(node);
+    } else if (node->getNodeType() == AST::Block) {
+        value = resolveConstant(node, scope);
+    }
+    if (value && (value->getNodeType() == AST::Int || value->getNodeType() == AST::Real)) {
+        values.push_back(value->toReal());
+        return true;
+    }
+    return false;
+}
+
+bool CodeResolver::evaluatePureFunction(std::shared_ptr<FunctionNode> function, std::vector<double> inputs,
+                                        std::vector<double> &outputs, QVector<ASTNode > scope, int depth)
+{
+    // Only modules made of a single stream from Input to Output through pure
+    // platform types and other such modules can be evaluated.
+    if (depth > 8 || function->getProperties().size() > 0) {
+        return false;
+    }
+    std::shared_ptr<DeclarationNode> module = CodeValidator::findDeclaration(
+                QString::fromStdString(function->getName()), scope, m_tree, function->getNamespaceList());
+    if (!module || module->getObjectType() != "module"
+            || !module->getPropertyValue("streams") || !module->getPropertyValue("blocks")) {
+        return false;
+    }
+    std::vector<ASTNode> streams = getModuleStreams(module);
+    if (streams.size() != 1) {
+        return false;
+    }
+    QVector<ASTNode> blocks = QVector<ASTNode>::fromStdVector(getModuleBlocks(module));
+    std::vector<double> values;
+    ASTNode node = streams.at(0);
+    bool first = true;
+    while (node) {
+        ASTNode member = node;
+        ASTNode rest = nullptr;
+        if (node->getNodeType() == AST::Stream) {
+            member = static_cast<StreamNode *>(node.get())->getLeft();
+            rest = static_cast<StreamNode *>(node.get())->getRight();
+        }
+        if (first) {
+            if (member->getNodeType() == AST::Block
+                    && static_cast<BlockNode *>(member.get())->getName() == "Input") {
+                values = inputs;
+            } else if (member->getNodeType() == AST::List) {
+                for (ASTNode element: member->getChildren()) { // e.g. [Input[1], Input[2]]
+                    if (element->getNodeType() != AST::Bundle
+                            || static_cast<BundleNode *>(element.get())->getName() != "Input") {
+                        return false;
+                    }
+                    std::vector<ASTNode> index = static_cast<BundleNode *>(element.get())->index()->getChildren();
+                    if (index.size() != 1 || index.at(0)->getNodeType() != AST::Int) {
+                        return false;
+                    }
+                    int i = static_cast<ValueNode *>(index.at(0).get())->getIntValue();
+                    if (i < 1 || i > (int) inputs.size()) {
+                        return false;
+                    }
+                    values.push_back(inputs.at(i - 1));
+                }
+            } else {
+                return false;
+            }
+            first = false;
+        } else if (!rest) {
+            if (member->getNodeType() == AST::Block
+                    && static_cast<BlockNode *>(member.get())->getName() == "Output") {
+                outputs = values;
+                return true;
+            }
+            return false;
+        } else {
+            string name;
+            if (member->getNodeType() == AST::Block) {
+                name = static_cast<BlockNode *>(member.get())->getName();
+            } else if (member->getNodeType() == AST::Function) {
+                name = static_cast<FunctionNode *>(member.get())->getName();
+            } else {
+                return false;
+            }
+            std::shared_ptr<DeclarationNode> block = CodeValidator::findDeclaration(
+                        QString::fromStdString(name), blocks, nullptr);
+            if (block) {
+                if (!evaluatePureBlock(block, values)) {
+                    return false;
+                }
+            } else if (member->getNodeType() == AST::Function) {
+                std::vector<double> result;
+                if (!evaluatePureFunction(static_pointer_cast<FunctionNode>(member), values, result, scope, depth + 1)) {
+                    return false;
+                }
+                values = result;
+            } else {
+                return false;
+            }
+        }
+        node = rest;
+    }
+    return false;
+}
+
+bool CodeResolver::evaluatePureBlock(std::shared_ptr<DeclarationNode> block, std::vector<double> &values)
+{
+    QList<LangError> errors;
+    std::shared_ptr<DeclarationNode> type = CodeValidator::findTypeDeclarationByName(
+                block->getObjectType(), QVector<ASTNode>(), m_tree, errors);
+    if (!type || type->getObjectType() != "platformType") {
+        return false;
+    }
+    ASTNode pure = type->getPropertyValue("pure");
+    if (!pure || pure->getNodeType() != AST::String) {
+        return false;
+    }
+    double result;
+    if (!applyPureOperation(static_cast<ValueNode *>(pure.get())->getStringValue(), values, result)) {
+        return false;
+    }
+    values.clear();
+    values.push_back(result);
+    return true;
+}
+
+bool CodeResolver::applyPureOperation(string operation, std::vector<double> inputs, double &result)
+{
+    if (inputs.size() == 1) {
+        double x = inputs.at(0);
+        if (operation == "sin") {
+            result = std::sin(x);
+        } else if (operation == "cos") {
+            result = std::cos(x);
+        } else if (operation == "tan") {
+            result = std::tan(x);
+        } else if (operation == "exp") {
+            result = std::exp(x);
+        } else if (operation == "log" && x > 0) {
+            result = std::log(x);
+        } else if (operation == "sqrt" && x >= 0) {
+            result = std::sqrt(x);
+        } else if (operation == "floor") {
+            result = std::floor(x);
+        } else if (operation == "ceil") {
+            result = std::ceil(x);
+        } else if (operation == "abs") {
+            result = std::fabs(x);
+        } else {
+            return false;
+        }
+    } else if (inputs.size() == 2 && operation == "pow") {
+        result = std::pow(inputs.at(0), inputs.at(1));
+    } else {
+        return false;
+    }
+    return std::isfinite(result);
+}
+
+void CodeResolver::removeDeadCode()
+{
+    m_moduleSideEffects.clear();
+    std::map<string, std::vector<std::shared_ptr<FunctionNode>>> calls;
+    collectCalls(m_tree, calls);
+    // Library modules can be the system's own objects (when they are not
+    // copied into the tree), so modules are trimmed on copies put in their place
+    std::vector<ASTNode> treeChildren;
+    for (ASTNode node: m_tree->getChildren()) {
+        if (node->getNodeType() == AST::Declaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(node);
+            if (decl->getObjectType() == "module" && calls.find(decl->getName()) != calls.end()) {
+                decl = static_pointer_cast<DeclarationNode>(decl->deepCopy());
+                removeDeadCodeInModule(decl, calls[decl->getName()]);
+                node = decl;
+            }
+        }
+        treeChildren.push_back(node);
+    }
+    m_tree->setChildren(treeChildren);
+
+    // Only sinks and side effects keep streams alive. Declarations don't, as
+    // library modules in the tree mention names of their own.
+    std::vector<ASTNode> streams;
+    for (ASTNode node: m_tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            streams.push_back(node);
+        }
+    }
+    std::vector<bool> live = findLiveStreams(streams, QVector<ASTNode>(), m_tree, std::set<string>());
+    std::vector<ASTNode> children;
+    std::set<string> deadNames;
+    size_t streamIndex = 0;
+    for (ASTNode node: m_tree->getChildren()) {
+        if (node->getNodeType() != AST::Stream || live[streamIndex++]) {
+            children.push_back(node);
+        } else {
+            collectNames(node, deadNames);
+        }
+    }
+    // Signals that were only used by the removed streams
+    std::set<string> referenced;
+    for (ASTNode node: children) {
+        collectNames(node, referenced);
+    }
+    std::vector<ASTNode> newChildren;
+    for (ASTNode node: children) {
+        if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(node);
+            if (decl->getObjectType() == "signal" && deadNames.find(decl->getName()) != deadNames.end()
+                    && referenced.find(decl->getName()) == referenced.end()) {
+                continue;
+            }
+        }
+        newChildren.push_back(node);
+    }
+    m_tree->setChildren(newChildren);
+}
+
+void CodeResolver::removeDeadCodeInModule(std::shared_ptr<DeclarationNode> module,
+                                          std::vector<std::shared_ptr<FunctionNode>> calls)
+{
+    ASTNode blocksNode = module->getPropertyValue("blocks");
+    ASTNode streamsNode = module->getPropertyValue("streams");
+    ASTNode portsNode = module->getPropertyValue("ports");
+    if (!blocksNode || blocksNode->getNodeType() != AST::List
+            || !streamsNode || streamsNode->getNodeType() != AST::List
+            || !portsNode || portsNode->getNodeType() != AST::List) {
+        return;
+    }
+    std::set<string> usedProperties;
+    for (std::shared_ptr<FunctionNode> call: calls) {
+        for (std::shared_ptr<PropertyNode> property: call->getProperties()) {
+            usedProperties.insert(property->getName());
+        }
+    }
+    // The main output and the output ports read by any caller are the sinks
+    std::set<string> liveNames;
+    for (ASTNode port: portsNode->getChildren()) {
+        if (port->getNodeType() != AST::Declaration) {
+            continue;
+        }
+        std::shared_ptr<DeclarationNode> portDeclaration = static_pointer_cast<DeclarationNode>(port);
+        ASTNode portBlock = portDeclaration->getPropertyValue("block");
+        ASTNode portName = portDeclaration->getPropertyValue("name");
+        if (!portBlock || portBlock->getNodeType() != AST::Block) {
+            continue;
+        }
+        if (portDeclaration->getObjectType() == "mainOutputPort"
+                || (portDeclaration->getObjectType() == "propertyOutputPort"
+                    && (!portName || portName->getNodeType() != AST::String
+                        || usedProperties.find(static_cast<ValueNode *>(portName.get())->getStringValue()) != usedProperties.end()))) {
+            liveNames.insert(static_cast<BlockNode *>(portBlock.get())->getName());
+        }
+    }
+    for (ASTNode block: blocksNode->getChildren()) {
+        collectNames(block, liveNames);
+    }
+    QVector<ASTNode> scope = QVector<ASTNode>::fromStdVector(blocksNode->getChildren());
+    std::vector<ASTNode> streams = streamsNode->getChildren();
+    std::vector<bool> live = findLiveStreams(streams, scope, nullptr, liveNames);
+    std::vector<ASTNode> liveStreams;
+    std::set<string> referenced;
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (live[i]) {
+            liveStreams.push_back(streams[i]);
+            collectNames(streams[i], referenced);
+        }
+    }
+    for (ASTNode block: blocksNode->getChildren()) {
+        collectNames(block, referenced);
+    }
+
+    // Ports whose blocks are no longer used are removed, together with the
+    // values passed to them in the calls.
+    std::vector<ASTNode> ports;
+    for (ASTNode port: portsNode->getChildren()) {
+        if (port->getNodeType() == AST::Declaration) {
+            std::shared_ptr<DeclarationNode> portDeclaration = static_pointer_cast<DeclarationNode>(port);
+            ASTNode portBlock = portDeclaration->getPropertyValue("block");
+            ASTNode portName = portDeclaration->getPropertyValue("name");
+            if (portBlock && portBlock->getNodeType() == AST::Block
+                    && portName && portName->getNodeType() == AST::String) {
+                string blockName = static_cast<BlockNode *>(portBlock.get())->getName();
+                string name = static_cast<ValueNode *>(portName.get())->getStringValue();
+                string portType = portDeclaration->getObjectType();
+                if (referenced.find(blockName) == referenced.end()
+                        && (portType == "propertyInputPort"
+                            || (portType == "propertyOutputPort" && usedProperties.find(name) == usedProperties.end()))) {
+                    if (portType == "propertyInputPort") {
+                        for (std::shared_ptr<FunctionNode> call: calls) {
+                            call->removeProperty(name);
+                        }
+                    }
+                    continue;
+                }
+                referenced.insert(blockName);
+            }
+        }
+        ports.push_back(port);
+    }
+
+    // Internal signals and side effect free blocks that are no longer used
+    std::vector<ASTNode> blocks;
+    for (ASTNode block: blocksNode->getChildren()) {
+        if (block->getNodeType() == AST::Declaration || block->getNodeType() == AST::BundleDeclaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(block);
+            bool sideEffects;
+            if (referenced.find(decl->getName()) == referenced.end()
+                    && (decl->getObjectType() == "signal" || (isPlatformBlock(decl, sideEffects) && !sideEffects))) {
+                continue;
+            }
+        }
+        blocks.push_back(block);
+    }
+    streamsNode->setChildren(liveStreams);
+    portsNode->setChildren(ports);
+    blocksNode->setChildren(blocks);
+}
+
+std::vector<bool> CodeResolver::findLiveStreams(std::vector<ASTNode> streams, QVector<ASTNode> scope, ASTNode tree,
+                                                std::set<string> liveNames)
+{
+    // A stream is live if it writes to a sink or calls something with side
+    // effects, or if it writes a name read by a live stream.
+    std::vector<std::set<string>> reads(streams.size()), writes(streams.size());
+    std::vector<bool> live(streams.size(), false);
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (streams[i]->getNodeType() != AST::Stream) {
+            live[i] = true;
+            collectNames(streams[i], reads[i]);
+            continue;
+        }
+        collectStreamNames(static_pointer_cast<StreamNode>(streams[i]), reads[i], writes[i]);
+        for (string name: writes[i]) {
+            if (!live[i] && isSinkName(name, scope, tree)) {
+                live[i] = true;
+            }
+        }
+        for (string name: reads[i]) {
+            if (!live[i] && hasSideEffects(name, scope)) {
+                live[i] = true;
+            }
+        }
+    }
+    std::vector<bool> counted(streams.size(), false);
+    std::set<string> visited;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < streams.size(); i++) {
+            for (auto name = writes[i].begin(); !live[i] && name != writes[i].end(); ++name) {
+                live[i] = liveNames.find(*name) != liveNames.end();
+            }
+            if (live[i] && !counted[i]) {
+                for (string name: reads[i]) {
+                    collectUsedNames(name, scope, tree, liveNames, visited);
+                }
+                counted[i] = true;
+                changed = true;
+            }
+        }
+    }
+    return live;
+}
+
+void CodeResolver::collectUsedNames(string name, QVector<ASTNode> scope, ASTNode tree,
+                                    std::set<string> &names, std::set<string> &visited)
+{
+    // Modules and reactions used by a live stream can read names from outside
+    names.insert(name);
+    if (!visited.insert(name).second) {
+        return;
+    }
+    std::shared_ptr<DeclarationNode> decl = CodeValidator::findDeclaration(QString::fromStdString(name), scope, tree);
+    if (decl && (decl->getObjectType() == "module" || decl->getObjectType() == "reaction")) {
+        std::set<string> usedNames;
+        collectNames(decl, usedNames);
+        for (string usedName: usedNames) {
+            collectUsedNames(usedName, scope, tree, names, visited);
+        }
+    }
+}
+
+bool CodeResolver::isSinkName(string name, QVector<ASTNode> scope, ASTNode tree)
+{
+    std::shared_ptr<DeclarationNode> decl = CodeValidator::findDeclaration(QString::fromStdString(name), scope, tree);
+    if (!decl) {
+        return true;
+    }
+    if (decl->getObjectType() == "signal") {
+        return false;
+    }
+    bool sideEffects;
+    return !isPlatformBlock(decl, sideEffects) || sideEffects;
+}
+
+bool CodeResolver::hasSideEffects(string name, QVector<ASTNode> scope, int depth)
+{
+    std::shared_ptr<DeclarationNode> decl = CodeValidator::findDeclaration(QString::fromStdString(name), scope, m_tree);
+    if (!decl) {
+        return true;
+    }
+    if (decl->getObjectType() == "module") {
+        return moduleHasSideEffects(decl, depth + 1);
+    } else if (decl->getObjectType() == "reaction") {
+        return true;
+    }
+    bool sideEffects = false;
+    isPlatformBlock(decl, sideEffects);
+    return sideEffects;
+}
+
+bool CodeResolver::moduleHasSideEffects(std::shared_ptr<DeclarationNode> module, int depth)
+{
+    auto known = m_moduleSideEffects.find(module.get());
+    if (known != m_moduleSideEffects.end()) {
+        return known->second;
+    }
+    ASTNode blocksNode = module->getPropertyValue("blocks");
+    if (depth > 16 || !blocksNode || blocksNode->getNodeType() != AST::List
+            || !module->getPropertyValue("streams")) {
+        return true;
+    }
+    m_moduleSideEffects[module.get()] = true; // Until known otherwise, e.g. for recursive modules
+    bool sideEffects = false;
+    QVector<ASTNode> scope = QVector<ASTNode>::fromStdVector(blocksNode->getChildren());
+    for (ASTNode block: scope) {
+        if (block->getNodeType() == AST::Declaration || block->getNodeType() == AST::BundleDeclaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(block);
+            bool blockEffects = false;
+            if (decl->getObjectType() == "reaction" || (isPlatformBlock(decl, blockEffects) && blockEffects)) {
+                sideEffects = true;
+            }
+        }
+    }
+    for (ASTNode stream: getModuleStreams(module)) {
+        std::set<string> reads, writes;
+        collectStreamNames(static_pointer_cast<StreamNode>(stream), reads, writes);
+        for (string name: writes) {
+            if (!CodeValidator::findDeclaration(QString::fromStdString(name), scope, nullptr)) {
+                sideEffects = true; // Writes outside the module
+            }
+        }
+        for (string name: reads) {
+            if (!sideEffects && hasSideEffects(name, scope, depth)) {
+                sideEffects = true;
+            }
+        }
+    }
+    m_moduleSideEffects[module.get()] = sideEffects;
+    return sideEffects;
+}
+
+bool CodeResolver::isPlatformBlock(std::shared_ptr<DeclarationNode> block, bool &sideEffects)
+{
+    QList<LangError> errors;
+    std::shared_ptr<DeclarationNode> type = CodeValidator::findTypeDeclarationByName(
+                block->getObjectType(), QVector<ASTNode>(), m_tree, errors);
+    if (!type || type->getObjectType() != "platformType") {
+        return false;
+    }
+    // Platform blocks without outputs write to hardware or other external
+    // state, and blocks with setup or teardown code must not be removed.
+    ASTNode outputs = type->getPropertyValue("outputs");
+    sideEffects = !outputs || outputs->getNodeType() != AST::List || outputs->getChildren().size() == 0;
+    for (string propertyName: {"globalInitializations", "initializations", "constructors",
+                               "preProcessingOnce", "postProcessing", "postProcessingOnce"}) {
+        if (!isEmptyCode(type->getPropertyValue(propertyName))) {
+            sideEffects = true;
+        }
+    }
+    return true;
+}
+
+bool CodeResolver::isEmptyCode(ASTNode value)
+{
+    if (!value || value->getNodeType() == AST::None) {
+        return true;
+    }
+    std::vector<ASTNode> code = value->getNodeType() == AST::List ? value->getChildren() : std::vector<ASTNode>{value};
+    for (ASTNode line: code) {
+        if (line->getNodeType() != AST::String || static_cast<ValueNode *>(line.get())->getStringValue().size() > 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CodeResolver::collectNames(ASTNode node, std::set<string> &names)
+{
+    if (node->getNodeType() == AST::Block) {
+        names.insert(static_cast<BlockNode *>(node.get())->getName());
+    } else if (node->getNodeType() == AST::Bundle) {
+        names.insert(static_cast<BundleNode *>(node.get())->getName());
+    } else if (node->getNodeType() == AST::Function) {
+        names.insert(static_cast<FunctionNode *>(node.get())->getName());
+    }
+    for (ASTNode child: node->getChildren()) {
+        collectNames(child, names);
+    }
+}
+
+void CodeResolver::collectStreamNames(std::shared_ptr<StreamNode> stream, std::set<string> &reads, std::set<string> &writes)
+{
+    // Blocks after the first stream member are written. Everything else is read.
+    ASTNode node = stream;
+    bool first = true;
+    while (node) {
+        ASTNode member = node;
+        node = nullptr;
+        if (member->getNodeType() == AST::Stream) {
+            node = static_cast<StreamNode *>(member.get())->getRight();
+            member = static_cast<StreamNode *>(member.get())->getLeft();
+        }
+        std::vector<ASTNode> elements = member->getNodeType() == AST::List ? member->getChildren() : std::vector<ASTNode>{member};
+        for (ASTNode element: elements) {
+            if (!first && element->getNodeType() == AST::Block) {
+                writes.insert(static_cast<BlockNode *>(element.get())->getName());
+            } else if (!first && element->getNodeType() == AST::Bundle) {
+                writes.insert(static_cast<BundleNode *>(element.get())->getName());
+                collectNames(static_cast<BundleNode *>(element.get())->index(), reads);
+            } else {
+                collectNames(element, reads);
+            }
+        }
+        first = false;
+    }
+}
+
+void CodeResolver::collectCalls(ASTNode node, std::map<string, std::vector<std::shared_ptr<FunctionNode>>> &calls)
+{
+    if (node->getNodeType() == AST::Function) {
+        calls[static_cast<FunctionNode *>(node.get())->getName()].push_back(static_pointer_cast<FunctionNode>(node));
+    }
+    for (ASTNode child: node->getChildren()) {
+        collectCalls(child, calls);
+    }
+}
+
+void CodeResolver::eliminateCommonSubexpressions()
+{
+    m_moduleSideEffects.clear();
+    for (ASTNode node: m_tree->getChildren()) {
+        if (node->getNodeType() == AST::Declaration
+                && static_cast<DeclarationNode *>(node.get())->getObjectType() == "module") {
+            std::shared_ptr<DeclarationNode> module = static_pointer_cast<DeclarationNode>(node);
+            ASTNode blocks = module->getPropertyValue("blocks");
+            ASTNode streams = module->getPropertyValue("streams");
+            if (blocks && blocks->getNodeType() == AST::List && streams && streams->getNodeType() == AST::List) {
+                std::vector<ASTNode> streamList = streams->getChildren();
+                std::vector<ASTNode> declarations;
+                QVector<ASTNode> scope = QVector<ASTNode>::fromStdVector(blocks->getChildren());
+                hoistCommonSubexpressions(streamList, scope, true, declarations);
+                hoistCommonSubexpressions(streamList, scope, false, declarations);
+                for (ASTNode declaration: declarations) {
+                    blocks->addChild(declaration);
+                }
+                streams->setChildren(streamList);
+            }
+        }
+    }
+
+    std::vector<ASTNode> streams;
+    for (ASTNode node: m_tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            streams.push_back(node);
+        }
+    }
+    std::vector<ASTNode> declarations;
+    hoistCommonSubexpressions(streams, QVector<ASTNode>(), true, declarations);
+    hoistCommonSubexpressions(streams, QVector<ASTNode>(), false, declarations);
+    // New streams go just before the first stream that used their value
+    std::vector<ASTNode> children;
+    size_t next = 0;
+    for (ASTNode node: m_tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            while (streams[next] != node) {
+                children.push_back(streams[next++]);
+            }
+            next++;
+        }
+        children.push_back(node);
+    }
+    children.insert(children.end(), declarations.begin(), declarations.end());
+    m_tree->setChildren(children);
+}
+
+void CodeResolver::hoistCommonSubexpressions(std::vector<ASTNode> &streams, QVector<ASTNode> scope,
+                                             bool functionCalls, std::vector<ASTNode> &declarations)
+{
+    // When functionCalls is set, the repeated parts are stream heads like
+    // [Phase, 1] >> Greater(). Otherwise they are expressions at the head of
+    // a stream. Each is computed once into a new signal by a stream placed
+    // before its first use. Only heads are shared, as anything after them can
+    // run at another rate.
+    struct Occurrence {
+        size_t stream;
+        ASTNode value;
+        std::function<void(ASTNode)> replace;
+    };
+    std::map<string, std::vector<Occurrence>> groups;
+    std::vector<string> keys; // In order of first occurrence
+    std::vector<std::set<string>> writes(streams.size());
+    std::vector<bool> effects(streams.size(), false);
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (streams[i]->getNodeType() != AST::Stream) {
+            effects[i] = true;
+            continue;
+        }
+        std::shared_ptr<StreamNode> stream = static_pointer_cast<StreamNode>(streams[i]);
+        std::set<string> reads;
+        collectStreamNames(stream, reads, writes[i]);
+        std::map<string, std::vector<std::shared_ptr<FunctionNode>>> calls;
+        collectCalls(stream, calls);
+        for (auto &call: calls) {
+            if (hasSideEffects(call.first, scope)) {
+                effects[i] = true;
+            }
+            for (std::shared_ptr<FunctionNode> function: call.second) {
+                for (std::shared_ptr<PropertyNode> property: function->getProperties()) {
+                    collectNames(property->getValue(), writes[i]); // Output ports are written through properties
+                }
+            }
+        }
+
+        // Values are only shared between streams in the same domain and rate,
+        // and only when the stream starts at the domain's rate
+        ASTNode last = stream;
+        while (last->getNodeType() == AST::Stream) {
+            last = static_cast<StreamNode *>(last.get())->getRight();
+        }
+        string domainName = CodeValidator::getNodeDomainName(last, scope, m_tree);
+        double baseRate = -1;
+        std::shared_ptr<DeclarationNode> domainDeclaration;
+        if (domainName.size() > 0) {
+            domainDeclaration = CodeValidator::findDomainDeclaration(domainName, m_tree);
+        }
+        if (domainDeclaration) {
+            baseRate = CodeValidator::findRateInProperties(domainDeclaration->getProperties(), scope, m_tree);
+        }
+        double rate = CodeValidator::getNodeRate(stream->getLeft(), scope, m_tree);
+        if (rate < 0) {
+            rate = baseRate;
+        }
+        if (baseRate >= 0 && rate != baseRate) {
+            continue;
+        }
+        char context[64];
+        snprintf(context, sizeof(context), "@%.17g:", rate);
+
+        std::vector<Occurrence> found;
+        if (functionCalls) {
+            if (stream->getRight()->getNodeType() == AST::Stream) {
+                std::shared_ptr<StreamNode> next = static_pointer_cast<StreamNode>(stream->getRight());
+                if (next->getLeft()->getNodeType() == AST::Function
+                        && isRepeatableFunction(static_pointer_cast<FunctionNode>(next->getLeft()), scope)) {
+                    ASTNode value = std::make_shared<StreamNode>(stream->getLeft(), next->getLeft(),
+                                                                 stream->getFilename().data(), stream->getLine());
+                    found.push_back({i, value, [stream, next](ASTNode result) {
+                                         stream->setLeft(result);
+                                         stream->setRight(next->getRight());
+                                     }});
+                }
+            }
+        } else {
+            ASTNode member = stream->getLeft();
+            if (member->getNodeType() == AST::Expression) {
+                found.push_back({i, member, [stream](ASTNode result) { stream->setLeft(result); }});
+            } else if (member->getNodeType() == AST::List) {
+                std::shared_ptr<ListNode> list = static_pointer_cast<ListNode>(member);
+                for (ASTNode element: list->getChildren()) {
+                    if (element->getNodeType() == AST::Expression) {
+                        found.push_back({i, element, [list, element](ASTNode result) {
+                                             list->replaceMember(result, element);
+                                         }});
+                    }
+                }
+            } else if (member->getNodeType() == AST::Function) {
+                for (std::shared_ptr<PropertyNode> property: static_cast<FunctionNode *>(member.get())->getProperties()) {
+                    if (property->getValue()->getNodeType() == AST::Expression) {
+                        found.push_back({i, property->getValue(), [property](ASTNode result) {
+                                             property->replaceValue(result);
+                                         }});
+                    }
+                }
+            }
+        }
+        for (Occurrence &occurrence: found) {
+            string key = domainName + context;
+            if (structuralKey(occurrence.value, key)) {
+                if (groups.find(key) == groups.end()) {
+                    keys.push_back(key);
+                }
+                groups[key].push_back(occurrence);
+            }
+        }
+    }
+
+    std::map<size_t, std::vector<ASTNode>> insertions;
+    for (string key: keys) {
+        std::vector<Occurrence> &occurrences = groups[key];
+        if (occurrences.size() < 2) {
+            continue;
+        }
+        ASTNode value = occurrences.front().value;
+        ASTNode input = value->getNodeType() == AST::Stream ? static_cast<StreamNode *>(value.get())->getLeft() : value;
+        std::map<string, std::vector<std::shared_ptr<FunctionNode>>> inputCalls;
+        collectCalls(input, inputCalls);
+        if (value->getNodeType() == AST::Stream) {
+            for (std::shared_ptr<PropertyNode> property:
+                 static_cast<FunctionNode *>(static_cast<StreamNode *>(value.get())->getRight().get())->getProperties()) {
+                collectCalls(property->getValue(), inputCalls);
+            }
+        }
+        std::set<string> reads;
+        collectNames(value, reads);
+        bool readsSignals = false;
+        bool valid = inputCalls.size() == 0;
+        for (string name: reads) {
+            std::shared_ptr<DeclarationNode> declaration = CodeValidator::findDeclaration(QString::fromStdString(name), scope, m_tree);
+            if (hasSideEffects(name, scope)) {
+                valid = false;
+            } else if (declaration && declaration->getObjectType() != "constant"
+                       && declaration->getObjectType() != "module") {
+                readsSignals = true;
+            }
+        }
+        QVector<ASTNode> sizeScope = scope;
+        QList<LangError> errors;
+        int size = value->getNodeType() == AST::Stream
+                ? CodeValidator::getNodeNumOutputs(static_cast<StreamNode *>(value.get())->getRight(), scope, m_tree, errors)
+                : CodeValidator::getNodeSize(value, sizeScope, m_tree);
+        if (!valid || !readsSignals || size != 1) {
+            continue;
+        }
+        // The inputs must not change between the new stream and any of the uses
+        size_t first = occurrences.front().stream;
+        size_t last = occurrences.back().stream;
+        for (size_t i = first; i < last; i++) {
+            if (effects[i]) {
+                valid = false;
+            }
+            for (string name: reads) {
+                if (writes[i].find(name) != writes[i].end()) {
+                    valid = false;
+                }
+            }
+        }
+        if (!valid) {
+            continue;
+        }
+
+        string name = "_Common_" + std::to_string(m_connectorCounter++);
+        std::shared_ptr<DeclarationNode> declaration = createSignalDeclaration(QString::fromStdString(name));
+        ASTNode domain = CodeValidator::getNodeDomain(input, scope, m_tree);
+        if (domain) {
+            declaration->setPropertyValue("domain", domain->deepCopy());
+        }
+        double rate = CodeValidator::getNodeRate(input, scope, m_tree);
+        if (rate >= 0) {
+            declaration->setPropertyValue("rate", std::make_shared<ValueNode>(rate, "", -1));
+        }
+        declarations.push_back(declaration);
+        scope.push_back(declaration);
+
+        ASTNode output = std::make_shared<BlockNode>(name, value->getFilename().data(), value->getLine());
+        ASTNode newStream;
+        if (value->getNodeType() == AST::Stream) {
+            StreamNode *call = static_cast<StreamNode *>(value.get());
+            newStream = std::make_shared<StreamNode>(call->getLeft(),
+                                                     std::make_shared<StreamNode>(call->getRight(), output, value->getFilename().data(), value->getLine()),
+                                                     value->getFilename().data(), value->getLine());
+        } else {
+            newStream = std::make_shared<StreamNode>(value, output, value->getFilename().data(), value->getLine());
+        }
+        insertions[first].push_back(newStream);
+        for (Occurrence &occurrence: occurrences) {
+            occurrence.replace(std::make_shared<BlockNode>(name, occurrence.value->getFilename().data(),
+                                                           occurrence.value->getLine()));
+        }
+    }
+
+    std::vector<ASTNode> newStreams;
+    for (size_t i = 0; i < streams.size(); i++) {
+        if (insertions.find(i) != insertions.end()) {
+            newStreams.insert(newStreams.end(), insertions[i].begin(), insertions[i].end());
+        }
+        newStreams.push_back(streams[i]);
+    }
+    streams = newStreams;
+}
+
+bool CodeResolver::isRepeatableFunction(std::shared_ptr<FunctionNode> function, QVector<ASTNode> scope, int depth)
+{
+    // Calls with the same inputs give the same output if the module has no side
+    // effects and its platform blocks keep no state, e.g. a random generator.
+    std::shared_ptr<DeclarationNode> module = CodeValidator::findDeclaration(
+                QString::fromStdString(function->getName()), scope, m_tree, function->getNamespaceList());
+    if (depth > 8 || !module || module->getObjectType() != "module" || moduleHasSideEffects(module, 0)) {
+        return false;
+    }
+    ASTNode blocks = module->getPropertyValue("blocks");
+    QVector<ASTNode> moduleScope = QVector<ASTNode>::fromStdVector(blocks->getChildren());
+    for (ASTNode block: moduleScope) {
+        if (block->getNodeType() == AST::Declaration || block->getNodeType() == AST::BundleDeclaration) {
+            QList<LangError> errors;
+            std::shared_ptr<DeclarationNode> type = CodeValidator::findTypeDeclarationByName(
+                        static_cast<DeclarationNode *>(block.get())->getObjectType(), QVector<ASTNode>(), m_tree, errors);
+            if (type && type->getObjectType() == "platformType" && !isEmptyCode(type->getPropertyValue("declarations"))) {
+                return false;
+            }
+        }
+    }
+    std::map<string, std::vector<std::shared_ptr<FunctionNode>>> calls;
+    for (ASTNode stream: getModuleStreams(module)) {
+        collectCalls(stream, calls);
+    }
+    for (auto &call: calls) {
+        for (std::shared_ptr<FunctionNode> internalCall: call.second) {
+            if (!isRepeatableFunction(internalCall, moduleScope, depth + 1)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool CodeResolver::structuralKey(ASTNode node, string &key)
+{
+    for (string scopeName: node->getNamespaceList()) {
+        key += scopeName + "::";
+    }
+    switch (node->getNodeType()) {
+    case AST::Int:
+        key += "i" + std::to_string(static_cast<ValueNode *>(node.get())->getIntValue());
+        return true;
+    case AST::Real: {
+        char text[32];
+        snprintf(text, sizeof(text), "r%.17g", static_cast<ValueNode *>(node.get())->getRealValue());
+        key += text;
+        return true;
+    }
+    case AST::String:
+        key += "s\"" + static_cast<ValueNode *>(node.get())->getStringValue() + "\"";
+        return true;
+    case AST::Switch:
+        key += static_cast<ValueNode *>(node.get())->getSwitchValue() ? "on" : "off";
+        return true;
+    case AST::Block:
+        key += "b" + static_cast<BlockNode *>(node.get())->getName();
+        return true;
+    case AST::PortProperty:
+        key += "p" + static_cast<PortPropertyNode *>(node.get())->getName()
+                + "." + static_cast<PortPropertyNode *>(node.get())->getPortName();
+        return true;
+    case AST::Bundle:
+        key += "b" + static_cast<BundleNode *>(node.get())->getName();
+        break;
+    case AST::Expression:
+        key += "e" + std::to_string(static_cast<ExpressionNode *>(node.get())->getExpressionType());
+        break;
+    case AST::Function:
+        key += "f" + static_cast<FunctionNode *>(node.get())->getName();
+        break;
+    case AST::Property:
+        key += "." + static_cast<PropertyNode *>(node.get())->getName();
+        break;
+    case AST::List:
+    case AST::Stream:
+        break;
+    default:
+        return false;
+    }
+    key += "(";
+    for (ASTNode child: node->getChildren()) {
+        if (!structuralKey(child, key)) {
+            return false;
+        }
+        key += ",";
+    }
+    key += ")";
+    return true;
+}
+
 void CodeResolver::processResetForNode(ASTNode thisScope, ASTNode streamScope, ASTNode upperScope)
 {
     map<std::shared_ptr<DeclarationNode>, string> resetMap; // Key is variable name, value is reset symbol
@@ -39,6 +39,9 @@
 #include <QVector>
 #include <QSharedPointer>
 
+#include <set>
+#include <map>
+
 #include "stridesystem.hpp"
 
 #include "ast.h"
@@ -48,6 +51,7 @@
 #include "propertynode.h"
 #include "declarationnode.h"
 #include "blocknode.h"
+#include "functionnode.h"
 #include "rangenode.h"
 #include "valuenode.h"
 #include "systemconfiguration.hpp"
@@ -56,11 +60,24 @@ class CodeResolver
 {
 public:
     CodeResolver(std::shared_ptr<StrideSystem> system, ASTNode tree,
-                 SystemConfiguration systemConfig);
+                 SystemConfiguration systemConfig, bool copyBuiltinObjects = false);
     ~CodeResolver();
 
     void preProcess();
 
+    // Generated connector names are numbered from this counter. Trees resolved
+    // separately and then merged must not reuse numbers.
+    void setConnectorCounter(int counter) { m_connectorCounter = counter; }
+    int getConnectorCounter() const { return m_connectorCounter; }
+
+    // Removes streams whose results never reach a sink and module blocks and
+    // ports that are not used. Must be run on a resolved and validated tree.
+    void removeDeadCode();
+
+    // Computes repeated side effect free expressions and function calls once
+    // into new signals. Must be run on a resolved and validated tree.
+    void eliminateCommonSubexpressions();
+
 private:
     // Main processing functions
     void processSystem();
@@ -112,6 +129,31 @@ private:
     std::shared_ptr<ValueNode> reduceConstExpression(std::shared_ptr<ExpressionNode> expr, QVector<ASTNode > scope, ASTNode tree);
     std::shared_ptr<ValueNode> resolveConstant(ASTNode value, QVector<ASTNode > scope);
     void resolveConstantsInNode(ASTNode node, QVector<ASTNode > scope);
+    // Compile time evaluation of platform types tagged "pure"
+    void foldPureFunctions(std::shared_ptr<StreamNode> stream, QVector<ASTNode > scope);
+    bool constantValues(ASTNode node, QVector<ASTNode > scope, std::vector<double> &values);
+    bool evaluatePureFunction(std::shared_ptr<FunctionNode> function, std::vector<double> inputs,
+                              std::vector<double> &outputs, QVector<ASTNode > scope, int depth = 0);
+    bool evaluatePureBlock(std::shared_ptr<DeclarationNode> block, std::vector<double> &values);
+    static bool applyPureOperation(string operation, std::vector<double> inputs, double &result);
+    void removeDeadCodeInModule(std::shared_ptr<DeclarationNode> module,
+                                std::vector<std::shared_ptr<FunctionNode>> calls);
+    std::vector<bool> findLiveStreams(std::vector<ASTNode> streams, QVector<ASTNode > scope, ASTNode tree,
+                                      std::set<string> liveNames);
+    void collectUsedNames(string name, QVector<ASTNode > scope, ASTNode tree,
+                          std::set<string> &names, std::set<string> &visited);
+    bool isSinkName(string name, QVector<ASTNode > scope, ASTNode tree);
+    bool hasSideEffects(string name, QVector<ASTNode > scope, int depth = 0);
+    bool moduleHasSideEffects(std::shared_ptr<DeclarationNode> module, int depth);
+    bool isPlatformBlock(std::shared_ptr<DeclarationNode> block, bool &sideEffects);
+    static bool isEmptyCode(ASTNode value);
+    void hoistCommonSubexpressions(std::vector<ASTNode> &streams, QVector<ASTNode> scope,
+                                   bool functionCalls, std::vector<ASTNode> &declarations);
+    bool isRepeatableFunction(std::shared_ptr<FunctionNode> function, QVector<ASTNode> scope, int depth = 0);
+    static bool structuralKey(ASTNode node, string &key);
+    static void collectNames(ASTNode node, std::set<string> &names);
+    static void collectStreamNames(std::shared_ptr<StreamNode> stream, std::set<string> &reads, std::set<string> &writes);
+    static void collectCalls(ASTNode node, std::map<string, std::vector<std::shared_ptr<FunctionNode>>> &calls);
     void processResetForNode(ASTNode thisScope, ASTNode streamScope, ASTNode upperScope);
     void propagateDomainsForNode(ASTNode node, QVector<ASTNode > scopeStack);
     void resolveDomainForStreamNode(ASTNode node, QVector<ASTNode > scope);
@@ -141,7 +183,9 @@ private:
     SystemConfiguration m_systemConfig;
     ASTNode m_tree;
     int m_connectorCounter;
+    bool m_copyBuiltinObjects; // Set when m_system is shared with other trees
     std::vector<std::vector<string>> m_bridgeAliases; //< 1: bridge signal 2: original name 3: domain
+    std::map<DeclarationNode *, bool> m_moduleSideEffects;
 };
 
 #endif // CODERESOLVER_H
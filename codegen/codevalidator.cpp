@@ -33,20 +33,66 @@
 */
 
 #include <memory>
+#include <functional>
 
 #include <QVector>
 #include <QDebug>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
 
 #include "codevalidator.h"
 #include "coderesolver.h"
+#include "incrementalresolver.hpp"
+
+class ValidationTask : public QRunnable
+{
+public:
+    ValidationTask(std::function<void()> work) : m_work(work) {}
+
+    void run() override {
+        m_work();
+    }
+
+private:
+    std::function<void()> m_work;
+};
 
 CodeValidator::CodeValidator(QString striderootDir, ASTNode tree, Options options,
                              SystemConfiguration systemConfig):
-    m_system(nullptr), m_tree(tree), m_options(options), m_systemConfig(systemConfig)
+    m_system(nullptr), m_tree(tree), m_options(options), m_systemConfig(systemConfig),
+    m_sharedSystem(false), m_resolver(nullptr)
 {
     validateTree(striderootDir, tree);
 }
 
+CodeValidator::CodeValidator(std::shared_ptr<StrideSystem> system, ASTNode tree, Options options,
+                             SystemConfiguration systemConfig):
+    m_system(system), m_tree(tree), m_options(options), m_systemConfig(systemConfig),
+    m_sharedSystem(true), m_resolver(nullptr)
+{
+    if (m_tree && m_system) {
+        QVector<std::shared_ptr<SystemNode>> systems = getPlatformNodes();
+        if (systems.size() > 0) { // Store system details in tree
+            systems.at(0)->setHwPlatforms(m_system->getFrameworkNames());
+        }
+        validate();
+    }
+}
+
+CodeValidator::CodeValidator(IncrementalResolver &resolver, ASTNode tree, Options options):
+    m_system(resolver.getSystem()), m_tree(tree), m_options(options),
+    m_sharedSystem(true), m_resolver(&resolver)
+{
+    if (m_tree && m_system) {
+        QVector<std::shared_ptr<SystemNode>> systems = getPlatformNodes();
+        if (systems.size() > 0) { // Store system details in tree
+            systems.at(0)->setHwPlatforms(m_system->getFrameworkNames());
+        }
+        validate();
+    }
+}
+
 CodeValidator::~CodeValidator()
 {
 }
@@ -460,26 +506,102 @@ void CodeValidator::validate()
         if(m_options & USE_TESTING) {
             m_system->enableTesting(true);
         }
-        CodeResolver resolver(m_system, m_tree, m_systemConfig);
-        resolver.preProcess();
+        m_system->loadDependencies(m_tree);
+        if (m_resolver) {
+            m_resolver->resolve(m_tree);
+        } else {
+            CodeResolver resolver(m_system, m_tree, m_systemConfig, m_sharedSystem);
+            resolver.preProcess();
+        }
         validatePlatform(m_tree, QVector<ASTNode >());
-        validateTypes(m_tree, QVector<ASTNode >());
-        validateBundleIndeces(m_tree, QVector<ASTNode >());
-        validateBundleSizes(m_tree, QVector<ASTNode >());
-        validateSymbolUniqueness(m_tree, QVector<ASTNode >());
         validateListTypeConsistency(m_tree, QVector<ASTNode >());
-        validateStreamSizes(m_tree, QVector<ASTNode >());
-        validateRates(m_tree);
+
+        // The remaining passes only read the resolved tree, so they are run
+        // concurrently for each top-level node, each task with its own errors.
+        vector<ASTNode> children = m_tree->getChildren();
+        QVector<ASTNode> topLevel = QVector<ASTNode>::fromStdVector(children);
+        // Bundle indeces are checked with the blocks of this and all previous nodes in scope
+        QVector<ASTNode> indexScope;
+        vector<int> indexScopeSizes;
+        for (ASTNode node: children) {
+            indexScope << getBlocksInScope(node, indexScope, m_tree);
+            indexScopeSizes.push_back(indexScope.size());
+        }
+        enum { TypesPass, BundleIndecesPass, BundleSizesPass, UniquenessPass, StreamSizesPass, RatesPass, PassCount };
+        size_t taskCount = PassCount * children.size();
+        vector<QList<LangError>> taskErrors(taskCount);
+        auto runTask = [&](size_t task) {
+            size_t i = task % children.size();
+            QList<LangError> &errors = taskErrors[task];
+            switch (task / children.size()) {
+            case TypesPass:
+                validateTypes(children[i], QVector<ASTNode >(), errors);
+                break;
+            case BundleIndecesPass:
+                validateBundleIndeces(children[i], indexScope.mid(0, indexScopeSizes[i]), errors);
+                break;
+            case BundleSizesPass:
+                validateBundleSizes(children[i], topLevel, errors);
+                break;
+            case UniquenessPass:
+                validateSymbolUniqueness(children[i], topLevel, errors);
+                break;
+            case StreamSizesPass:
+                validateStreamSizes(children[i], QVector<ASTNode >(), errors);
+                break;
+            case RatesPass:
+                if ((m_options & NO_RATE_VALIDATION) == 0) {
+                    validateNodeRate(children[i], m_tree, errors);
+                }
+                break;
+            }
+        };
+        int threads = QThread::idealThreadCount();
+        if (threads <= 1 || children.size() < 32) { // Not worth starting threads
+            for (size_t task = 0; task < taskCount; task++) {
+                runTask(task);
+            }
+        } else {
+            QThreadPool pool;
+            size_t chunkSize = taskCount / (threads * 4) + 1;
+            for (size_t first = 0; first < taskCount; first += chunkSize) {
+                size_t last = std::min(first + chunkSize, taskCount);
+                pool.start(new ValidationTask([&runTask, first, last]() {
+                    for (size_t task = first; task < last; task++) {
+                        runTask(task);
+                    }
+                }));
+            }
+            pool.waitForDone();
+        }
+        for (QList<LangError> errors: taskErrors) {
+            m_errors << errors;
+        }
 
 //         TODO: validate expression type consistency
 //         TODO: validate expression list operations
 
-
+        // Optimizations are only done once the whole program has been checked,
+        // so errors are reported against the code as written.
+        if ((m_options & OPTIMIZE) && m_errors.size() == 0) {
+            if (m_resolver) {
+                // Incremental validation leaves the resolved tree as it is
+                // and optimizes a copy. See getTree()
+                m_tree = m_tree->deepCopy();
+            }
+            CodeResolver resolver(m_system, m_tree, m_systemConfig, m_sharedSystem);
+            if (m_options & ELIMINATE_COMMON_SUBEXPRESSIONS) {
+                resolver.eliminateCommonSubexpressions();
+            }
+            if (m_options & ELIMINATE_DEAD_CODE) {
+                resolver.removeDeadCode();
+            }
+        }
     }
     sortErrors();
 }
 
-void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, vector<string> parentNamespace)
+void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, QList<LangError> &validationErrors, vector<string> parentNamespace)
 {
     if (node->getNodeType() == AST::BundleDeclaration
             || node->getNodeType() == AST::Declaration) {
@@ -493,7 +615,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             error.lineNumber = block->getLine();
             error.errorTokens.push_back(block->getObjectType());
             error.filename = block->getFilename();
-            m_errors << error;
+            validationErrors << error;
         } else {
             // Validate port names and types
             vector<std::shared_ptr<PropertyNode>> ports = block->getProperties();
@@ -509,7 +631,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                         error.errorTokens.push_back(blockType.toStdString());
                         error.errorTokens.push_back(portName.toStdString());
                         error.filename = port->getFilename();
-                        m_errors << error;
+                        validationErrors << error;
                     } else {
                         // Then check type passed to port is valid
                         bool typeIsValid = false;
@@ -563,7 +685,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                                 error.errorTokens.push_back(typeName.toStdString());
                                 error.errorTokens.push_back(validTypeNames.join(",").toStdString());
                                 error.filename = port->getFilename();
-                                m_errors << error;
+                                validationErrors << error;
                             }
                         }
                     }
@@ -576,11 +698,11 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
         }
         // For BundleDeclarations in particular, we need to ingnore the bundle when delcaring types. The inner bundle has no scope set, and trying to find it will fail if the declaration is scoped....
         foreach(auto property, block->getProperties()) {
-            validateTypes(property->getValue(), scopeStack, block->getNamespaceList());
+            validateTypes(property->getValue(), scopeStack, validationErrors, block->getNamespaceList());
         }
         return;
     } else if (node->getNodeType() == AST::Stream) {
-        validateStreamMembers(static_cast<StreamNode *>(node.get()), scopeStack);
+        validateStreamMembers(static_cast<StreamNode *>(node.get()), scopeStack, validationErrors);
         return; // Children are validated when validating stream
     } else if (node->getNodeType() == AST::List) {
          // Children are checked automatically below
@@ -607,7 +729,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             }
             blockName += block->getName();
             error.errorTokens.push_back(blockName);
-            m_errors << error;
+            validationErrors << error;
         }
 
     } else if (node->getNodeType() == AST::Bundle) {
@@ -633,7 +755,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             }
             bundleName += bundle->getName();
             error.errorTokens.push_back(bundleName);
-            m_errors << error;
+            validationErrors << error;
         }
     } else if (node->getNodeType() == AST::Function) {
         FunctionNode *func = static_cast<FunctionNode *>(node.get());
@@ -656,7 +778,7 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
             }
             funcName += func->getName();
             error.errorTokens.push_back(funcName);
-            m_errors << error;
+            validationErrors << error;
         } else {
             for (std::shared_ptr<PropertyNode> property : func->getProperties()) {
                 string propertyName = property->getName();
@@ -669,25 +791,25 @@ void CodeValidator::validateTypes(ASTNode node, QVector<ASTNode > scopeStack, ve
                     error.errorTokens.push_back(func->getName());
                     error.errorTokens.push_back(propertyName);
                     error.filename = func->getFilename();
-                    m_errors << error;
+                    validationErrors << error;
                 }
             }
         }
     }
 
     foreach(ASTNode childNode, node->getChildren()) {
-        validateTypes(childNode, scopeStack);
+        validateTypes(childNode, scopeStack, validationErrors);
     }
 }
 
-void CodeValidator::validateStreamMembers(StreamNode *stream, QVector<ASTNode > scopeStack)
+void CodeValidator::validateStreamMembers(StreamNode *stream, QVector<ASTNode > scopeStack, QList<LangError> &validationErrors)
 {
     ASTNode member = stream->getLeft();
     QString name;
     while (member) {
-        validateTypes(member, scopeStack);
+        validateTypes(member, scopeStack, validationErrors);
         if (stream && stream->getRight()->getNodeType() == AST::Stream) {
-            validateStreamMembers(static_cast<StreamNode *>(stream->getRight().get()), scopeStack);
+            validateStreamMembers(static_cast<StreamNode *>(stream->getRight().get()), scopeStack, validationErrors);
             return;
         } else {
             if (stream) {
@@ -700,7 +822,7 @@ void CodeValidator::validateStreamMembers(StreamNode *stream, QVector<ASTNode >
     }
 }
 
-void CodeValidator::validateBundleIndeces(ASTNode node, QVector<ASTNode > scope)
+void CodeValidator::validateBundleIndeces(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors)
 {
     if (node->getNodeType() == AST::Bundle) {
         BundleNode *bundle = static_cast<BundleNode *>(node.get());
@@ -711,17 +833,17 @@ void CodeValidator::validateBundleIndeces(ASTNode node, QVector<ASTNode > scope)
             error.lineNumber = bundle->getLine();
             error.errorTokens.push_back(bundle->getName());
             error.errorTokens.push_back(getPortTypeName(type).toStdString());
-            m_errors << error;
+            validationErrors << error;
         }
     }
     for(ASTNode child: node->getChildren()) {
         QVector<ASTNode > subScope = getBlocksInScope(child, scope, m_tree);
         scope << subScope;
-        validateBundleIndeces(child, scope);
+        validateBundleIndeces(child, scope, validationErrors);
     }
 }
 
-void CodeValidator::validateBundleSizes(ASTNode node, QVector<ASTNode > scope)
+void CodeValidator::validateBundleSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors)
 {
     if (node->getNodeType() == AST::BundleDeclaration) {
         QList<LangError> errors;
@@ -736,20 +858,20 @@ void CodeValidator::validateBundleSizes(ASTNode node, QVector<ASTNode > scope)
             error.errorTokens.push_back(block->getBundle()->getName());
             error.errorTokens.push_back(QString::number(size).toStdString());
             error.errorTokens.push_back(QString::number(datasize).toStdString());
-            m_errors << error;
+            validationErrors << error;
         }
 
         // TODO : use this pass to store the computed value of constant int?
-        m_errors << errors;
+        validationErrors << errors;
     }
 
     QVector<ASTNode > children = QVector<ASTNode >::fromStdVector(node->getChildren());
     foreach(ASTNode node, children) {
-        validateBundleSizes(node, children);
+        validateBundleSizes(node, children, validationErrors);
     }
 }
 
-void CodeValidator::validateSymbolUniqueness(ASTNode node, QVector<ASTNode > scope)
+void CodeValidator::validateSymbolUniqueness(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors)
 {
     // TODO: This only checks symbol uniqueness within its scope...
 
@@ -775,7 +897,7 @@ void CodeValidator::validateSymbolUniqueness(ASTNode node, QVector<ASTNode > sco
                     error.errorTokens.push_back(nodeName.toStdString());
                     error.errorTokens.push_back(node->getFilename());
                     error.errorTokens.push_back(std::to_string(node->getLine()));
-                    m_errors << error;
+                    validationErrors << error;
                 }
             }
         }
@@ -783,7 +905,7 @@ void CodeValidator::validateSymbolUniqueness(ASTNode node, QVector<ASTNode > sco
 
     QVector<ASTNode > children = QVector<ASTNode >::fromStdVector(node->getChildren());
     for(ASTNode node: children) {
-        validateSymbolUniqueness(node, children);
+        validateSymbolUniqueness(node, children, validationErrors);
     }
 }
 
@@ -798,7 +920,7 @@ void CodeValidator::validateListTypeConsistency(ASTNode node, QVector<ASTNode >
 //            error.lineNumber = node->getLine();
 //            // TODO: provide more information on inconsistent list
 ////            error.errorTokens <<
-//            m_errors << error;
+//            validationErrors << error;
 //        }
 //    }
 
@@ -808,35 +930,24 @@ void CodeValidator::validateListTypeConsistency(ASTNode node, QVector<ASTNode >
 //    }
 }
 
-void CodeValidator::validateStreamSizes(ASTNode tree, QVector<ASTNode > scope)
+void CodeValidator::validateStreamSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors)
 {
-    for(ASTNode node: tree->getChildren()) {
-        if(node->getNodeType() == AST::Stream) {
-            StreamNode *stream = static_cast<StreamNode *>(node.get());
-            validateStreamInputSize(stream, scope, m_errors);
-        } else if (node->getNodeType() == AST::Declaration) {
-            DeclarationNode *decl = static_cast<DeclarationNode *>(node.get());
-            if (decl) {
-                if (decl->getObjectType() == "module"
-                        || decl->getObjectType() == "reaction") {
+    if(node->getNodeType() == AST::Stream) {
+        StreamNode *stream = static_cast<StreamNode *>(node.get());
+        validateStreamInputSize(stream, scope, validationErrors);
+    } else if (node->getNodeType() == AST::Declaration) {
+        DeclarationNode *decl = static_cast<DeclarationNode *>(node.get());
+        if (decl) {
+            if (decl->getObjectType() == "module"
+                    || decl->getObjectType() == "reaction") {
 
-                    // FIXME we need to validate streams within modules and reactions
-                }
+                // FIXME we need to validate streams within modules and reactions
             }
         }
     }
 }
 
-void CodeValidator::validateRates(ASTNode tree)
-{
-    if ((m_options & NO_RATE_VALIDATION) == 0) {
-        for(ASTNode node: tree->getChildren()) {
-            validateNodeRate(node, tree);
-        }
-    }
-}
-
-void CodeValidator::validateNodeRate(ASTNode node, ASTNode tree)
+void CodeValidator::validateNodeRate(ASTNode node, ASTNode tree, QList<LangError> &validationErrors)
 {
     if(node->getNodeType() == AST::Declaration
             || node->getNodeType() == AST::BundleDeclaration) {
@@ -848,20 +959,20 @@ void CodeValidator::validateNodeRate(ASTNode node, ASTNode tree)
 //                error.lineNumber = node->getLine();
 //                error.filename = node->getFilename();
 //                error.errorTokens.push_back(decl->getName());
-//                m_errors << error;
+//                validationErrors << error;
 //            }
         }
     } else if(node->getNodeType() == AST::Stream) {
         StreamNode *stream = static_cast<StreamNode *>(node.get());
-        validateNodeRate(stream->getLeft(), tree);
-        validateNodeRate(stream->getRight(), tree);
+        validateNodeRate(stream->getLeft(), tree, validationErrors);
+        validateNodeRate(stream->getRight(), tree, validationErrors);
     } else if(node->getNodeType() == AST::Expression) {
         for(ASTNode child: node->getChildren()) {
-            validateNodeRate(child, tree);
+            validateNodeRate(child, tree, validationErrors);
         }
     } else if(node->getNodeType() == AST::Function) {
         for(std::shared_ptr<PropertyNode> prop: static_cast<FunctionNode *>(node.get())->getProperties()) {
-            validateNodeRate(prop->getValue(), tree);
+            validateNodeRate(prop->getValue(), tree, validationErrors);
         }
     }
     // TODO also need to validate rates within module and reaction streams
@@ -874,7 +985,8 @@ bool errorLineIsLower(const LangError &err1, const LangError &err2)
 
 void CodeValidator::sortErrors()
 {
-    std::sort(m_errors.begin(), m_errors.end(), errorLineIsLower);
+    // Stable, so errors on the same line keep the order of the passes
+    std::stable_sort(m_errors.begin(), m_errors.end(), errorLineIsLower);
 }
 
 void CodeValidator::validateStreamInputSize(StreamNode *stream, QVector<ASTNode > scope, QList<LangError> &errors)
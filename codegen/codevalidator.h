@@ -45,6 +45,8 @@
 #include "stridesystem.hpp"
 #include "systemconfiguration.hpp"
 
+class IncrementalResolver;
+
 class CodeValidator
 {
 public:
@@ -53,10 +55,20 @@ public:
         NO_OPTIONS = 0x00,
         NO_RATE_VALIDATION = 0x01,
         USE_TESTING = 0x02,
+        ELIMINATE_DEAD_CODE = 0x04,
+        ELIMINATE_COMMON_SUBEXPRESSIONS = 0x08,
+        OPTIMIZE = 0x0C,
     } Options;
 
     CodeValidator(QString striderootDir, ASTNode tree = nullptr, Options options = NO_OPTIONS,
                   SystemConfiguration systemConfig = SystemConfiguration());
+    /// Validate tree against an already loaded system. The system can be shared
+    /// between validators, e.g. to avoid parsing the library for every file.
+    CodeValidator(std::shared_ptr<StrideSystem> system, ASTNode tree, Options options = NO_OPTIONS,
+                  SystemConfiguration systemConfig = SystemConfiguration());
+    /// Validate a new version of a program, re-resolving only what changed
+    /// since resolver last saw it. The system and configuration are the resolver's.
+    CodeValidator(IncrementalResolver &resolver, ASTNode tree, Options options = NO_OPTIONS);
     ~CodeValidator();
 
     bool isValid();
@@ -143,6 +155,8 @@ public:
 
     static vector<StreamNode *> getStreamsAtLine(ASTNode tree, int line);
 
+    /// When optimizing with an IncrementalResolver this is an optimized copy
+    /// and the tree passed in is left as resolved.
     ASTNode getTree() const;
     void setTree(const ASTNode &tree);
 
@@ -153,19 +167,21 @@ private:
     QVector<std::shared_ptr<SystemNode> > getPlatformNodes();
 
     void validatePlatform(ASTNode node, QVector<ASTNode > scopeStack);
-    void validateTypes(ASTNode node, QVector<ASTNode > scopeStack, vector<string> parentNamespace = vector<string>());
-    void validateStreamMembers(StreamNode *node, QVector<ASTNode > scopeStack);
-    void validateBundleIndeces(ASTNode node, QVector<ASTNode > scope);
-    void validateBundleSizes(ASTNode node, QVector<ASTNode > scope);
-    void validateSymbolUniqueness(ASTNode node, QVector<ASTNode > scope);
     void validateListTypeConsistency(ASTNode node, QVector<ASTNode > scope);
-    void validateStreamSizes(ASTNode tree, QVector<ASTNode > scope);
-    void validateRates(ASTNode tree);
+
+    // These passes run concurrently. They must only read the tree and report to validationErrors
+    void validateTypes(ASTNode node, QVector<ASTNode > scopeStack, QList<LangError> &validationErrors,
+                       vector<string> parentNamespace = vector<string>());
+    void validateStreamMembers(StreamNode *node, QVector<ASTNode > scopeStack, QList<LangError> &validationErrors);
+    void validateBundleIndeces(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors);
+    void validateBundleSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors);
+    void validateSymbolUniqueness(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors);
+    void validateStreamSizes(ASTNode node, QVector<ASTNode > scope, QList<LangError> &validationErrors);
 
     void sortErrors();
 
     void validateStreamInputSize(StreamNode *stream, QVector<ASTNode > scope, QList<LangError> &errors);
-    void validateNodeRate(ASTNode node, ASTNode tree);
+    void validateNodeRate(ASTNode node, ASTNode tree, QList<LangError> &validationErrors);
 
     int getBlockDataSize(std::shared_ptr<DeclarationNode> block, QVector<ASTNode > scope, QList<LangError> &errors);
 
@@ -176,6 +192,8 @@ private:
     QList<LangError> m_errors;
     Options m_options;
     SystemConfiguration m_systemConfig;
+    bool m_sharedSystem;
+    IncrementalResolver *m_resolver;
 };
 
 #endif // CODEGEN_H
@@ -0,0 +1,424 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <functional>
+#include <algorithm>
+#include <map>
+
+#include <QMutexLocker>
+
+#include "incrementalresolver.hpp"
+#include "coderesolver.h"
+
+#include "blocknode.h"
+#include "bundlenode.h"
+#include "declarationnode.h"
+#include "functionnode.h"
+#include "propertynode.h"
+#include "valuenode.h"
+#include "expressionnode.h"
+#include "keywordnode.h"
+#include "importnode.h"
+#include "portpropertynode.h"
+#include "scopenode.h"
+#include "platformnode.h"
+
+IncrementalResolver::IncrementalResolver(std::shared_ptr<StrideSystem> system,
+                                         SystemConfiguration systemConfig) :
+    m_system(system), m_systemConfig(systemConfig), m_builtinFileCount(-1),
+    m_connectorCounter(0), m_reused(0), m_resolved(0)
+{
+}
+
+void IncrementalResolver::resolve(ASTNode tree)
+{
+    QMutexLocker locker(&m_mutex);
+    m_reused = 0;
+    m_resolved = 0;
+    std::set<std::string> builtinNames = getBuiltinNames();
+
+    // The platform, imports and declarations that replace builtin objects can
+    // affect every group, so they are part of every group
+    vector<ASTNode> contextNodes;
+    vector<ASTNode> userNodes;
+    std::set<std::string> userNames;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
+            std::string name = static_cast<DeclarationNode *>(node.get())->getName();
+            if (builtinNames.find(name) != builtinNames.end()) {
+                contextNodes.push_back(node);
+                continue;
+            }
+            userNames.insert(name);
+            userNodes.push_back(node);
+        } else if (node->getNodeType() == AST::Stream) {
+            userNodes.push_back(node);
+        } else {
+            contextNodes.push_back(node);
+        }
+    }
+
+    // Group nodes that share names
+    vector<size_t> groupOf(userNodes.size());
+    std::map<std::string, size_t> nameOwner;
+    std::function<size_t(size_t)> findGroup = [&](size_t i) {
+        while (groupOf[i] != i) {
+            groupOf[i] = groupOf[groupOf[i]];
+            i = groupOf[i];
+        }
+        return i;
+    };
+    for (size_t i = 0; i < userNodes.size(); i++) {
+        groupOf[i] = i;
+        std::set<std::string> names;
+        collectNames(userNodes[i], names, userNames);
+        for (std::string name: names) {
+            auto owner = nameOwner.find(name);
+            if (owner == nameOwner.end()) {
+                nameOwner[name] = i;
+            } else {
+                size_t a = findGroup(i), b = findGroup(owner->second);
+                groupOf[std::max(a, b)] = std::min(a, b); // Keep the earliest node as root
+            }
+        }
+    }
+    vector<vector<ASTNode>> groups;
+    std::map<size_t, size_t> groupIndex;
+    for (size_t i = 0; i < userNodes.size(); i++) {
+        size_t root = findGroup(i);
+        if (groupIndex.find(root) == groupIndex.end()) {
+            groupIndex[root] = groups.size();
+            groups.push_back(vector<ASTNode>());
+        }
+        groups[groupIndex[root]].push_back(userNodes[i]);
+    }
+    if (groups.size() == 0) {
+        groups.push_back(vector<ASTNode>()); // Resolve the context on its own
+    }
+
+    std::string filename = userNodes.size() > 0 ? userNodes[0]->getFilename() : tree->getFilename();
+    QCryptographicHash contextHash(QCryptographicHash::Sha1);
+    contextHash.addData(filename.data(), (int) filename.size());
+    for (ASTNode node: contextNodes) {
+        addSignature(node, 0, contextHash);
+    }
+    QByteArray contextSignature = contextHash.result();
+
+    vector<ASTNode> newChildren;
+    for (ASTNode node: contextNodes) {
+        if (node->getNodeType() == AST::Platform || node->getNodeType() == AST::Import) {
+            newChildren.push_back(node);
+        }
+    }
+    std::map<std::string, ASTNode> mergedDeclarations;
+    QMap<QByteArray, CachedGroup> usedGroups;
+    for (vector<ASTNode> group: groups) {
+        int firstLine = group.size() > 0 ? group.front()->getLine() : 0;
+        QCryptographicHash hash(QCryptographicHash::Sha1);
+        hash.addData(contextSignature);
+        for (ASTNode node: group) {
+            addSignature(node, firstLine, hash);
+        }
+        QByteArray signature = hash.result();
+
+        vector<ASTNode> resolvedNodes;
+        if (m_cache.contains(signature)) {
+            const CachedGroup &cached = m_cache[signature];
+            for (size_t i = 0; i < cached.nodes.size(); i++) {
+                ASTNode copy = cached.nodes[i]->deepCopy();
+                if (cached.fromGroup[i] && firstLine != cached.firstLine) {
+                    shiftLines(copy, filename, firstLine - cached.firstLine);
+                }
+                resolvedNodes.push_back(copy);
+            }
+            usedGroups[signature] = cached;
+            m_reused++;
+        } else {
+            ASTNode groupTree = std::make_shared<AST>();
+            std::set<AST *> contextCopies;
+            for (ASTNode node: contextNodes) {
+                ASTNode copy = node->deepCopy();
+                contextCopies.insert(copy.get());
+                groupTree->addChild(copy);
+            }
+            for (ASTNode node: group) {
+                groupTree->addChild(node);
+            }
+            CodeResolver resolver(m_system, groupTree, m_systemConfig, true);
+            resolver.setConnectorCounter(m_connectorCounter);
+            resolver.preProcess();
+            m_connectorCounter = resolver.getConnectorCounter();
+
+            CachedGroup cached;
+            cached.firstLine = firstLine;
+            for (ASTNode node: groupTree->getChildren()) {
+                if (node->getNodeType() == AST::Platform || node->getNodeType() == AST::Import) {
+                    continue;
+                }
+                resolvedNodes.push_back(node);
+                cached.nodes.push_back(node->deepCopy());
+                cached.fromGroup.push_back(contextCopies.find(node.get()) == contextCopies.end());
+            }
+            usedGroups[signature] = cached;
+            m_resolved++;
+        }
+
+        // Library objects and builtin types are inserted by every group, and
+        // each group annotates its copy for its own uses. Keep one copy and
+        // merge the others into it
+        std::map<std::string, ASTNode> groupDeclarations;
+        for (ASTNode node: resolvedNodes) {
+            if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
+                std::string key;
+                for (std::string ns: node->getNamespaceList()) {
+                    key += ns + "::";
+                }
+                key += static_cast<DeclarationNode *>(node.get())->getName();
+                auto merged = mergedDeclarations.find(key);
+                if (merged != mergedDeclarations.end()) {
+                    mergeDeclaration(static_cast<DeclarationNode *>(merged->second.get()),
+                                     static_cast<DeclarationNode *>(node.get()));
+                    continue;
+                }
+                groupDeclarations[key] = node;
+            }
+            newChildren.push_back(node);
+        }
+        mergedDeclarations.insert(groupDeclarations.begin(), groupDeclarations.end());
+    }
+    tree->setChildren(newChildren);
+    m_cache = usedGroups; // Only keep what the current version of the program uses
+}
+
+void IncrementalResolver::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+    m_builtinFileCount = -1;
+    m_builtinNames.clear();
+}
+
+std::set<std::string> IncrementalResolver::getBuiltinNames()
+{
+    // Library files are loaded as programs need them, so reread the names when more are loaded
+    if (m_system && m_system->loadedFileCount() != m_builtinFileCount) {
+        m_builtinNames.clear();
+        map<string, vector<ASTNode>> objects = m_system->getBuiltinObjectsReference();
+        for (auto it = objects.begin(); it != objects.end(); it++) {
+            for (ASTNode object: it->second) {
+                if (object->getNodeType() == AST::Declaration
+                        || object->getNodeType() == AST::BundleDeclaration) {
+                    m_builtinNames.insert(static_cast<DeclarationNode *>(object.get())->getName());
+                }
+            }
+        }
+        m_builtinFileCount = m_system->loadedFileCount();
+    }
+    return m_builtinNames;
+}
+
+void IncrementalResolver::collectNames(ASTNode node, std::set<std::string> &names,
+                                       const std::set<std::string> &userNames)
+{
+    if (node->getNodeType() == AST::Block) {
+        names.insert(static_cast<BlockNode *>(node.get())->getName());
+    } else if (node->getNodeType() == AST::Bundle) {
+        names.insert(static_cast<BundleNode *>(node.get())->getName());
+    } else if (node->getNodeType() == AST::Function) {
+        // Library modules are copied into each group, so they don't join groups
+        std::string name = static_cast<FunctionNode *>(node.get())->getName();
+        if (userNames.find(name) != userNames.end()) {
+            names.insert(name);
+        }
+    } else if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
+        DeclarationNode *declaration = static_cast<DeclarationNode *>(node.get());
+        names.insert(declaration->getName());
+        if (userNames.find(declaration->getObjectType()) != userNames.end()) {
+            names.insert(declaration->getObjectType());
+        }
+    } else if (node->getNodeType() == AST::PortProperty) {
+        names.insert(static_cast<PortPropertyNode *>(node.get())->getName());
+    }
+    for (ASTNode child: node->getChildren()) {
+        if (child) {
+            collectNames(child, names, userNames);
+        }
+    }
+}
+
+void IncrementalResolver::addSignature(ASTNode node, int baseLine, QCryptographicHash &hash)
+{
+    QByteArray data = QByteArray::number((int) node->getNodeType()) + " ";
+    data += node->getLine() >= 0 ? QByteArray::number(node->getLine() - baseLine) : QByteArray("-");
+    for (std::string ns: node->getNamespaceList()) {
+        data += " " + QByteArray::fromStdString(ns);
+    }
+    switch (node->getNodeType()) {
+    case AST::Block:
+        data += " " + QByteArray::fromStdString(static_cast<BlockNode *>(node.get())->getName());
+        break;
+    case AST::Bundle:
+        data += " " + QByteArray::fromStdString(static_cast<BundleNode *>(node.get())->getName());
+        break;
+    case AST::Function:
+        data += " " + QByteArray::fromStdString(static_cast<FunctionNode *>(node.get())->getName());
+        break;
+    case AST::Declaration:
+    case AST::BundleDeclaration:
+        data += " " + QByteArray::fromStdString(static_cast<DeclarationNode *>(node.get())->getName())
+                + " " + QByteArray::fromStdString(static_cast<DeclarationNode *>(node.get())->getObjectType());
+        break;
+    case AST::Property:
+        data += " " + QByteArray::fromStdString(static_cast<PropertyNode *>(node.get())->getName());
+        break;
+    case AST::Int:
+        data += " " + QByteArray::number(static_cast<ValueNode *>(node.get())->getIntValue());
+        break;
+    case AST::Real:
+        data += " " + QByteArray::number(static_cast<ValueNode *>(node.get())->getRealValue(), 'g', 17);
+        break;
+    case AST::String:
+        data += " " + QByteArray::fromStdString(static_cast<ValueNode *>(node.get())->getStringValue());
+        break;
+    case AST::Switch:
+        data += static_cast<ValueNode *>(node.get())->getSwitchValue() ? " on" : " off";
+        break;
+    case AST::Expression:
+        data += " " + QByteArray::number((int) static_cast<ExpressionNode *>(node.get())->getExpressionType());
+        break;
+    case AST::Keyword:
+        data += " " + QByteArray::fromStdString(static_cast<KeywordNode *>(node.get())->keyword());
+        break;
+    case AST::Import:
+        data += " " + QByteArray::fromStdString(static_cast<ImportNode *>(node.get())->importName())
+                + " " + QByteArray::fromStdString(static_cast<ImportNode *>(node.get())->importAlias());
+        break;
+    case AST::PortProperty:
+        data += " " + QByteArray::fromStdString(static_cast<PortPropertyNode *>(node.get())->getName())
+                + " " + QByteArray::fromStdString(static_cast<PortPropertyNode *>(node.get())->getPortName());
+        break;
+    case AST::Scope:
+        data += " " + QByteArray::fromStdString(static_cast<ScopeNode *>(node.get())->getName());
+        break;
+    case AST::Platform:
+        data += " " + QByteArray::fromStdString(static_cast<SystemNode *>(node.get())->platformName())
+                + " " + QByteArray::number(static_cast<SystemNode *>(node.get())->majorVersion())
+                + "." + QByteArray::number(static_cast<SystemNode *>(node.get())->minorVersion());
+        break;
+    default:
+        break;
+    }
+    vector<ASTNode> children = node->getChildren();
+    data += " (" + QByteArray::number((int) children.size()) + ")\n";
+    hash.addData(data);
+    for (ASTNode child: children) {
+        if (child) {
+            addSignature(child, baseLine, hash);
+        } else {
+            hash.addData("null\n");
+        }
+    }
+}
+
+void IncrementalResolver::mergeDeclaration(DeclarationNode *kept, DeclarationNode *other)
+{
+    for (std::shared_ptr<PropertyNode> property: other->getProperties()) {
+        ASTNode value = property->getValue();
+        ASTNode keptValue = kept->getPropertyValue(property->getName());
+        if (!keptValue) { // e.g. defaults filled in for this group's uses only
+            kept->addProperty(std::static_pointer_cast<PropertyNode>(property->deepCopy()));
+        } else if (keptValue->getNodeType() == AST::None && value->getNodeType() != AST::None) {
+            kept->replacePropertyValue(property->getName(), value->deepCopy());
+        } else if (keptValue->getNodeType() == AST::List && value->getNodeType() == AST::List) {
+            // Only annotation lists (like _reads and _writes) collect one
+            // entry per use. Other lists (like streams) are rebuilt by every
+            // group, so only their declarations are merged
+            mergeList(keptValue, value, property->getName()[0] == '_');
+        } else if ((keptValue->getNodeType() == AST::Declaration || keptValue->getNodeType() == AST::BundleDeclaration)
+                   && keptValue->getNodeType() == value->getNodeType()) {
+            mergeDeclaration(static_cast<DeclarationNode *>(keptValue.get()),
+                             static_cast<DeclarationNode *>(value.get()));
+        }
+    }
+}
+
+void IncrementalResolver::mergeList(ASTNode kept, ASTNode other, bool annotations)
+{
+    std::set<QByteArray> keptSignatures;
+    if (annotations) {
+        for (ASTNode child: kept->getChildren()) {
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            addSignature(child, 0, hash);
+            keptSignatures.insert(hash.result());
+        }
+    }
+    for (ASTNode child: other->getChildren()) {
+        if (child->getNodeType() == AST::Declaration || child->getNodeType() == AST::BundleDeclaration) {
+            std::string name = static_cast<DeclarationNode *>(child.get())->getName();
+            ASTNode match;
+            for (ASTNode keptChild: kept->getChildren()) {
+                if (keptChild->getNodeType() == child->getNodeType()
+                        && static_cast<DeclarationNode *>(keptChild.get())->getName() == name) {
+                    match = keptChild;
+                    break;
+                }
+            }
+            if (match) {
+                mergeDeclaration(static_cast<DeclarationNode *>(match.get()),
+                                 static_cast<DeclarationNode *>(child.get()));
+            } else {
+                kept->addChild(child->deepCopy());
+            }
+        } else if (annotations) {
+            // Copies of the same use are identical, including their line
+            QCryptographicHash hash(QCryptographicHash::Sha1);
+            addSignature(child, 0, hash);
+            if (keptSignatures.insert(hash.result()).second) {
+                kept->addChild(child->deepCopy());
+            }
+        }
+    }
+}
+
+void IncrementalResolver::shiftLines(ASTNode node, std::string filename, int delta)
+{
+    if (node->getFilename() == filename && node->getLine() >= 0) {
+        node->setLine(node->getLine() + delta);
+    }
+    for (ASTNode child: node->getChildren()) {
+        if (child) {
+            shiftLines(child, filename, delta);
+        }
+    }
+}
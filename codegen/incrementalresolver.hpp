@@ -0,0 +1,106 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef INCREMENTALRESOLVER_HPP
+#define INCREMENTALRESOLVER_HPP
+
+#include <memory>
+#include <vector>
+#include <set>
+#include <string>
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QCryptographicHash>
+
+#include "ast.h"
+#include "declarationnode.h"
+#include "stridesystem.hpp"
+#include "systemconfiguration.hpp"
+
+/// Resolves successive versions of the same program, reusing earlier results
+/// for the parts that did not change.
+///
+/// Top-level streams and declarations are split into groups that share no
+/// names (the names of library modules don't count, as each group gets its
+/// own copy of them). Each group is resolved on its own against the platform
+/// and imports, and the result is kept under a hash of the group's subtrees.
+/// When the same group is found in a later tree, only shifted by whole lines,
+/// a copy of the earlier result is used instead of resolving it again.
+/// The copies of library modules annotated by each group are merged back into
+/// one declaration.
+///
+/// The system must not be modified by resolution, so it is used as a shared
+/// system (builtin objects are copied into the tree).
+class IncrementalResolver
+{
+public:
+    IncrementalResolver(std::shared_ptr<StrideSystem> system,
+                        SystemConfiguration systemConfig = SystemConfiguration());
+
+    /// Resolve tree in place. The equivalent of CodeResolver::preProcess()
+    void resolve(ASTNode tree);
+
+    std::shared_ptr<StrideSystem> getSystem() { return m_system; }
+    int reusedGroups() const { return m_reused; } // From last call to resolve()
+    int resolvedGroups() const { return m_resolved; }
+    void clear();
+
+private:
+    typedef struct {
+        std::vector<ASTNode> nodes;
+        std::vector<bool> fromGroup; // false for nodes copied from the context
+        int firstLine;
+    } CachedGroup;
+
+    std::set<std::string> getBuiltinNames();
+    void collectNames(ASTNode node, std::set<std::string> &names, const std::set<std::string> &userNames);
+    void addSignature(ASTNode node, int baseLine, QCryptographicHash &hash);
+    void mergeDeclaration(DeclarationNode *kept, DeclarationNode *other);
+    void mergeList(ASTNode kept, ASTNode other, bool annotations);
+    void shiftLines(ASTNode node, std::string filename, int delta);
+
+    std::shared_ptr<StrideSystem> m_system;
+    SystemConfiguration m_systemConfig;
+    std::set<std::string> m_builtinNames;
+    int m_builtinFileCount; // Loaded library files when m_builtinNames was read. -1 if not read
+    QMap<QByteArray, CachedGroup> m_cache;
+    int m_connectorCounter;
+    int m_reused;
+    int m_resolved;
+    QMutex m_mutex;
+};
+
+#endif // INCREMENTALRESOLVER_HPP
@@ -36,8 +36,13 @@
 #include <QDebug>
 #include <QDir>
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QDirIterator>
+#include <QCryptographicHash>
+#include <QProcessEnvironment>
 
 #include "pythonproject.h"
+#include "pythonworker.h"
 #include "stridesystem.hpp"
 #include "codevalidator.h"
 
@@ -58,6 +63,7 @@ PythonProject::PythonProject(QString platformName, QString platformPath, QString
     }
 
     m_jsonFilename = m_projectDir + QDir::separator() + "tree-" + platformName + ".json";
+    m_stampFilename = m_projectDir + QDir::separator() + "build-" + platformName + ".json";
 
     QObject::connect(&m_buildProcess, SIGNAL(readyReadStandardOutput()) , this, SLOT(consoleMessage()));
     QObject::connect(&m_buildProcess, SIGNAL(readyReadStandardError()) , this, SLOT(consoleMessage()));
@@ -77,15 +83,7 @@ PythonProject::~PythonProject()
 
 bool PythonProject::build(ASTNode tree)
 {
-    writeAST(tree);
-    QStringList arguments;
-    if (m_buildProcess.state() == QProcess::Running) {
-        m_buildProcess.close();
-        if (!m_buildProcess.waitForFinished(5000)) {
-            qDebug() << "Could not stop build process. Not starting again.";
-            return false;
-        }
-    }
+    QJsonArray treeJson = writeAST(tree);
     // Write configuration file to json
     QJsonDocument configJson = QJsonDocument::fromVariant(m_configuration);
     QFile configFile(m_projectDir + QDir::separator() + "config.json");
@@ -94,9 +92,52 @@ bool PythonProject::build(ASTNode tree)
         configFile.close();
     }
 
-    // Start Build
     m_stdErr.clear();
     m_stdOut.clear();
+
+    // Skip generation and compilation if the products were built from the same
+    // resolved tree, configuration and framework
+    QByteArray signature = buildSignature(treeJson);
+    if (isBuildCurrent(signature)) {
+        emit outputText("Products are up to date.");
+        return true;
+    }
+    QFile::remove(m_stampFilename);
+    QDateTime buildStart = QDateTime::currentDateTime();
+
+    // Build in the persistent worker, which keeps the generator modules loaded
+    QJsonObject request;
+    request["command"] = QString("build");
+    request["jsonfile"] = m_jsonFilename;
+    request["products_dir"] = m_projectDir;
+    request["debug"] = true;
+    QJsonObject reply;
+    WorkerResult result = requestWorker(request, m_building, reply);
+    if (result == WorkerTimedOut) {
+        emit errorText("Build timed out.");
+        return false;
+    } else if (result == WorkerStopped) {
+        return false;
+    } else if (result == WorkerDone) {
+        if (reply["status"].toInt() == 0) {
+            writeBuildStamp(signature, buildStart);
+            emit outputText("Done building. Success.");
+            return true;
+        } else {
+            emit outputText("Done building. Failed.");
+            return false;
+        }
+    }
+
+    // Worker not available. Start a build process
+    QStringList arguments;
+    if (m_buildProcess.state() == QProcess::Running) {
+        m_buildProcess.close();
+        if (!m_buildProcess.waitForFinished(5000)) {
+            qDebug() << "Could not stop build process. Not starting again.";
+            return false;
+        }
+    }
     m_buildProcess.setWorkingDirectory(m_strideRoot);
     // FIXME un hard-code library version
     arguments << "library/1.0/python/build.py" << m_jsonFilename << m_projectDir << m_strideRoot << "build";
@@ -104,10 +145,18 @@ bool PythonProject::build(ASTNode tree)
 
     m_buildProcess.waitForStarted(15000);
 //    qDebug() << "pid:" << m_buildProcess.pid();
+    QElapsedTimer timer;
+    timer.start();
     m_building.store(1);
     while(m_building.load() == 1) {
         if(m_buildProcess.waitForFinished(50)) {
             m_building.store(0);
+        } else if (m_timeout > 0 && timer.hasExpired(m_timeout)) {
+            m_buildProcess.kill();
+            m_buildProcess.waitForFinished();
+            m_building.store(0);
+            emit errorText("Build timed out.");
+            return false;
         }
         qApp->processEvents();
     }
@@ -115,6 +164,7 @@ bool PythonProject::build(ASTNode tree)
     qApp->processEvents();
     if (m_buildProcess.exitStatus() == QProcess::ExitStatus::NormalExit
             && m_buildProcess.exitCode() == 0) {
+        writeBuildStamp(signature, buildStart);
         emit outputText("Done building. Success.");
         return true;
     } else {
@@ -139,17 +189,50 @@ bool PythonProject::run(bool pressed)
     }
     m_stdErr.clear();
     m_stdOut.clear();
-    m_runningProcess.setWorkingDirectory(m_strideRoot);
+    QString program = m_pythonExecutable;
+    QString workingDirectory = m_strideRoot;
     // FIXME un hard-code library version
     arguments << "library/1.0/python/build.py" << m_jsonFilename << m_projectDir << m_strideRoot << "run";
-    m_runningProcess.start(m_pythonExecutable, arguments);
+
+    // If the framework can tell how to run the program, run it directly
+    // instead of through a new python process
+    QJsonObject request;
+    request["command"] = QString("run_command");
+    request["jsonfile"] = m_jsonFilename;
+    request["products_dir"] = m_projectDir;
+    QJsonObject reply;
+    if (requestWorker(request, m_running, reply) == WorkerDone
+            && reply["status"].toInt() == 0 && reply.contains("arguments")) {
+        QJsonArray runArguments = reply["arguments"].toArray();
+        if (runArguments.size() > 0) {
+            program = runArguments.takeAt(0).toString();
+            arguments.clear();
+            for (QJsonValue argument: runArguments) {
+                arguments << argument.toString();
+            }
+            workingDirectory = reply["directory"].toString();
+        }
+    }
+    m_stdErr.clear(); // Only keep the program's output
+    m_stdOut.clear();
+    m_runningProcess.setWorkingDirectory(workingDirectory);
+    m_runningProcess.start(program, arguments);
 
     m_runningProcess.waitForStarted(15000);
     qDebug() << "run pid:" << m_runningProcess.pid();
+    QElapsedTimer timer;
+    timer.start();
     m_running.store(1);
     while(m_running.load() == 1) {
         if(m_runningProcess.waitForFinished(50)) {
             m_running.store(0);
+        } else if (m_timeout > 0 && timer.hasExpired(m_timeout)) {
+            m_runningProcess.kill();
+            m_runningProcess.waitForFinished();
+            m_running.store(0);
+            emit errorText("Run timed out.");
+            emit programStopped();
+            return false;
         }
         qApp->processEvents();
     }
@@ -179,7 +262,38 @@ void PythonProject::stopRunning()
     //m_runningProcess.waitForFinished();
 }
 
-void PythonProject::writeAST(ASTNode tree)
+PythonProject::WorkerResult PythonProject::requestWorker(QJsonObject request, QAtomicInt &activeFlag, QJsonObject &reply)
+{
+    PythonWorker *worker = PythonWorker::getWorker(m_pythonExecutable, m_strideRoot, m_platformPath);
+    QObject::connect(worker, SIGNAL(outputText(QString)), this, SLOT(workerOutput(QString)));
+    QObject::connect(worker, SIGNAL(errorText(QString)), this, SLOT(workerError(QString)));
+    WorkerResult result = WorkerDone;
+    if (!worker->sendRequest(request)) {
+        result = WorkerUnavailable;
+    } else {
+        QElapsedTimer timer;
+        timer.start();
+        activeFlag.store(1);
+        while (!worker->waitForReply(50)) {
+            if (activeFlag.load() == 0) { // stopRunning() called
+                worker->stop();
+                result = WorkerStopped;
+                break;
+            } else if (m_timeout > 0 && timer.hasExpired(m_timeout)) {
+                worker->stop();
+                result = WorkerTimedOut;
+                break;
+            }
+            qApp->processEvents();
+        }
+        activeFlag.store(0);
+        reply = worker->getReply();
+    }
+    QObject::disconnect(worker, 0, this, 0);
+    return result;
+}
+
+QJsonArray PythonProject::writeAST(ASTNode tree)
 {
     QJsonArray treeObject;
     for(ASTNode node : tree->getChildren()) {
@@ -196,10 +310,128 @@ void PythonProject::writeAST(ASTNode tree)
 
     if (!saveFile.open(QIODevice::WriteOnly)) {
         qWarning("Couldn't open save file.");
-        return;
+        return treeObject;
     }
     QJsonDocument saveDoc(treeObject);
     saveFile.write(saveDoc.toJson());
+    return treeObject;
+}
+
+// Removes source positions so edits that only move code don't change the signature
+static QJsonValue stripSourcePositions(QJsonValue value)
+{
+    if (value.isObject()) {
+        QJsonObject object = value.toObject();
+        object.remove("line");
+        object.remove("filename");
+        for (auto it = object.begin(); it != object.end(); ++it) {
+            it.value() = stripSourcePositions(it.value());
+        }
+        return object;
+    } else if (value.isArray()) {
+        QJsonArray array = value.toArray();
+        for (int i = 0; i < array.size(); i++) {
+            array[i] = stripSourcePositions(array[i]);
+        }
+        return array;
+    }
+    return value;
+}
+
+// Adds the path, size and modification time of every file under path
+static void addDirectorySignature(QCryptographicHash &hash, QString path)
+{
+    QStringList entries;
+    QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        if (info.fileName().endsWith(".pyc") || info.path().contains("__pycache__")) {
+            continue;
+        }
+        entries << QString("%1 %2 %3").arg(info.filePath()).arg(info.size())
+                   .arg(info.lastModified().toMSecsSinceEpoch());
+    }
+    entries.sort(); // Iteration order is not defined
+    hash.addData(entries.join('\n').toUtf8());
+}
+
+QByteArray PythonProject::buildSignature(const QJsonArray &tree)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QJsonArray signatureTree = tree;
+    if (!m_configuration.value("Profile").toBool()) { // Profiles report source lines
+        signatureTree = stripSourcePositions(tree).toArray();
+    }
+    hash.addData(QJsonDocument(signatureTree).toJson(QJsonDocument::Compact));
+    hash.addData(QJsonDocument::fromVariant(m_configuration).toJson(QJsonDocument::Compact));
+    hash.addData(m_platformName.toUtf8());
+    hash.addData(m_projectDir.toUtf8());
+    addDirectorySignature(hash, m_platformPath);
+    // FIXME un hard-code library version
+    addDirectorySignature(hash, m_strideRoot + QDir::separator() + "library/1.0/python");
+    // Compiler selection and flags can come from the environment
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    for (QString variable: QStringList() << "CC" << "CXX" << "CFLAGS" << "CXXFLAGS" << "LDFLAGS" << "PATH") {
+        hash.addData((variable + "=" + environment.value(variable) + "\n").toUtf8());
+    }
+    return hash.result().toHex();
+}
+
+bool PythonProject::isBuildCurrent(QByteArray signature)
+{
+    QFile stampFile(m_stampFilename);
+    if (!stampFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QJsonObject stamp = QJsonDocument::fromJson(stampFile.readAll()).object();
+    if (stamp["signature"].toString().toLatin1() != signature) {
+        return false;
+    }
+    // The products written by the build must still be there and unchanged
+    QJsonObject products = stamp["products"].toObject();
+    QDir projectDir(m_projectDir);
+    for (auto it = products.constBegin(); it != products.constEnd(); ++it) {
+        QFileInfo info(projectDir.absoluteFilePath(it.key()));
+        QJsonArray sizeAndTime = it.value().toArray();
+        if (!info.exists() || info.size() != sizeAndTime.at(0).toDouble()
+                || info.lastModified().toMSecsSinceEpoch() != sizeAndTime.at(1).toDouble()) {
+            return false;
+        }
+    }
+    return products.size() > 0;
+}
+
+void PythonProject::writeBuildStamp(QByteArray signature, QDateTime buildStart)
+{
+    // Record the files this build wrote
+    QJsonObject products;
+    QDir projectDir(m_projectDir);
+    qint64 startTime = buildStart.toMSecsSinceEpoch() - 2000; // Allow for coarse file system timestamps
+    QDirIterator it(m_projectDir, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        QFileInfo info = it.fileInfo();
+        QString path = info.absoluteFilePath();
+        // Build inputs are rewritten on every build, so they are not products
+        if ((info.absolutePath() == projectDir.absolutePath()
+             && (info.fileName().startsWith("tree-") || info.fileName().startsWith("build-")
+                 || info.fileName() == "config.json"))
+                || info.lastModified().toMSecsSinceEpoch() < startTime) {
+            continue;
+        }
+        QJsonArray sizeAndTime;
+        sizeAndTime.append((double) info.size());
+        sizeAndTime.append((double) info.lastModified().toMSecsSinceEpoch());
+        products[projectDir.relativeFilePath(path)] = sizeAndTime;
+    }
+    QJsonObject stamp;
+    stamp["signature"] = QString::fromLatin1(signature);
+    stamp["products"] = products;
+    QFile stampFile(m_stampFilename);
+    if (stampFile.open(QIODevice::WriteOnly)) {
+        stampFile.write(QJsonDocument(stamp).toJson());
+    }
 }
 
 void PythonProject::astToJson(ASTNode node, QJsonObject &obj)
@@ -478,6 +710,18 @@ bool PythonProject::isValid()
     return true;
 }
 
+void PythonProject::workerOutput(QString text)
+{
+    m_stdOut.append(text);
+    emit outputText(text);
+}
+
+void PythonProject::workerError(QString text)
+{
+    m_stdErr.append(text);
+    emit errorText(text);
+}
+
 void PythonProject::consoleMessage()
 {
     QByteArray stdOut;
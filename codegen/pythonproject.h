@@ -42,6 +42,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QProcess>
+#include <QDateTime>
 
 #include "builder.h"
 
@@ -74,11 +75,19 @@ public slots:
     virtual bool isValid() override;
 
     void consoleMessage();
+    void workerOutput(QString text);
+    void workerError(QString text);
 
     void stopRunning();
 
 private:
-    void writeAST(ASTNode tree);
+    enum WorkerResult { WorkerDone, WorkerUnavailable, WorkerTimedOut, WorkerStopped };
+    WorkerResult requestWorker(QJsonObject request, QAtomicInt &activeFlag, QJsonObject &reply);
+
+    QJsonArray writeAST(ASTNode tree);
+    QByteArray buildSignature(const QJsonArray &tree);
+    bool isBuildCurrent(QByteArray signature);
+    void writeBuildStamp(QByteArray signature, QDateTime buildStart);
     void astToJson(ASTNode node, QJsonObject &obj);
     void listToJsonArray(std::shared_ptr<ListNode> node, QJsonArray &obj);
     void streamToJsonArray(std::shared_ptr<StreamNode> node, QJsonArray &array);
@@ -89,6 +98,7 @@ private:
     QString m_platformName;
     QString m_pythonExecutable;
     QString m_jsonFilename;
+    QString m_stampFilename;
     QAtomicInt m_running;
     QProcess m_runningProcess;
     QAtomicInt m_building;
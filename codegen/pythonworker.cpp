@@ -0,0 +1,156 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <cstring>
+
+#include <QDebug>
+#include <QMap>
+#include <QtAlgorithms>
+#include <QThreadStorage>
+#include <QJsonDocument>
+
+#include "pythonworker.h"
+
+#define WORKER_REPLY_MARKER "STRIDE_WORKER_DONE "
+
+// Workers owned by a thread, one per platform. Killed when the thread exits.
+class PythonWorkerRegistry
+{
+public:
+    ~PythonWorkerRegistry() { qDeleteAll(workers); }
+    QMap<QString, PythonWorker *> workers;
+};
+
+static QThreadStorage<PythonWorkerRegistry *> workerRegistry;
+
+PythonWorker::PythonWorker(QString pythonExecutable, QString strideRoot) :
+    m_pythonExecutable(pythonExecutable),
+    m_strideRoot(strideRoot),
+    m_process(this),
+    m_waiting(false)
+{
+}
+
+PythonWorker::~PythonWorker()
+{
+    if (m_process.state() == QProcess::Running) {
+        m_process.write("{\"command\": \"quit\"}\n");
+        if (!m_process.waitForFinished(1000)) {
+            m_process.kill();
+            m_process.waitForFinished();
+        }
+    }
+}
+
+PythonWorker *PythonWorker::getWorker(QString pythonExecutable, QString strideRoot, QString platformPath)
+{
+    if (!workerRegistry.hasLocalData()) {
+        workerRegistry.setLocalData(new PythonWorkerRegistry);
+    }
+    QMap<QString, PythonWorker *> &workers = workerRegistry.localData()->workers;
+    QString key = pythonExecutable + "|" + strideRoot + "|" + platformPath;
+    if (!workers.contains(key)) {
+        workers[key] = new PythonWorker(pythonExecutable, strideRoot);
+    }
+    return workers[key];
+}
+
+bool PythonWorker::sendRequest(QJsonObject request)
+{
+    if (m_waiting) {
+        qDebug() << "Python worker is busy.";
+        return false;
+    }
+    if (m_process.state() != QProcess::Running) {
+        m_outputBuffer.clear();
+        m_process.setWorkingDirectory(m_strideRoot);
+        // FIXME un hard-code library version
+        m_process.start(m_pythonExecutable, QStringList() << "-u" << "library/1.0/python/build.py"
+                        << "--worker" << m_strideRoot);
+        if (!m_process.waitForStarted(15000)) {
+            qDebug() << "Could not start python worker.";
+            return false;
+        }
+    }
+    QByteArray line = QJsonDocument(request).toJson(QJsonDocument::Compact) + "\n";
+    if (m_process.write(line) != line.size()) {
+        return false;
+    }
+    m_reply = QJsonObject();
+    m_waiting = true;
+    return true;
+}
+
+bool PythonWorker::waitForReply(int msecs)
+{
+    if (!m_waiting) {
+        return true;
+    }
+    m_process.waitForReadyRead(msecs);
+    readOutput();
+    if (m_waiting && m_process.state() != QProcess::Running) {
+        readOutput();
+        m_reply["status"] = -1;
+        m_waiting = false;
+        emit errorText("Python worker exited.");
+    }
+    return !m_waiting;
+}
+
+void PythonWorker::stop()
+{
+    m_process.kill();
+    m_process.waitForFinished();
+    m_waiting = false;
+}
+
+void PythonWorker::readOutput()
+{
+    QByteArray stdErr = m_process.readAllStandardError();
+    if (!stdErr.isEmpty()) {
+        emit errorText(stdErr);
+    }
+    m_outputBuffer.append(m_process.readAllStandardOutput());
+    int end;
+    while (m_waiting && (end = m_outputBuffer.indexOf('\n')) >= 0) {
+        QByteArray line = m_outputBuffer.left(end + 1);
+        m_outputBuffer.remove(0, end + 1);
+        if (line.startsWith(WORKER_REPLY_MARKER)) {
+            m_reply = QJsonDocument::fromJson(line.mid(strlen(WORKER_REPLY_MARKER))).object();
+            m_waiting = false;
+        } else {
+            emit outputText(line);
+        }
+    }
+}
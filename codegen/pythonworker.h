@@ -0,0 +1,78 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef PYTHONWORKER_H
+#define PYTHONWORKER_H
+
+#include <QObject>
+#include <QString>
+#include <QProcess>
+#include <QJsonObject>
+
+// Long running "build.py --worker" process. Keeps the code generation modules
+// loaded between builds. Requests are JSON objects written one per line to
+// the worker's stdin. Output is forwarded through outputText() and errorText()
+// until the worker writes its reply line.
+// A worker serves a single platform and is only used from the thread that
+// created it. Use getWorker() to get the worker for the current thread.
+class PythonWorker : public QObject
+{
+    Q_OBJECT
+public:
+    PythonWorker(QString pythonExecutable, QString strideRoot);
+    virtual ~PythonWorker();
+
+    static PythonWorker *getWorker(QString pythonExecutable, QString strideRoot, QString platformPath);
+
+    bool sendRequest(QJsonObject request); // Starts the worker process if needed
+    bool waitForReply(int msecs); // Returns true once the reply has arrived or the worker died
+    QJsonObject getReply() const { return m_reply; }
+    void stop(); // Kills the worker. It is restarted on the next request
+
+signals:
+    void outputText(QString text);
+    void errorText(QString text);
+
+private:
+    void readOutput();
+
+    QString m_pythonExecutable;
+    QString m_strideRoot;
+    QProcess m_process;
+    QByteArray m_outputBuffer;
+    bool m_waiting;
+    QJsonObject m_reply;
+};
+
+#endif // PYTHONWORKER_H
@@ -61,20 +61,31 @@ StrideLibrary::~StrideLibrary()
     }
 }
 
-void StrideLibrary::setLibraryPath(QString strideRootPath, QMap<QString, QString> importList)
+void StrideLibrary::setLibraryPath(QString strideRootPath, QMap<QString, QString> importList, bool lazy)
 {
 //    foreach(ASTNode node, m_libraryTrees) {
 //        node->deleteChildren();
 ////        delete node;
 //    }
     m_libraryTrees.clear();
+    m_libraryFiles.clear();
 
-    readLibrary(strideRootPath, importList);
+    readLibrary(strideRootPath, importList, lazy);
+}
+
+void StrideLibrary::setFileTree(int index, ASTNode tree)
+{
+    if (index >= 0 && index < m_libraryTrees.size()) {
+        m_libraryTrees[index] = tree;
+    }
 }
 
 std::shared_ptr<DeclarationNode> StrideLibrary::findTypeInLibrary(QString typeName)
 {
     for (ASTNode rootNode : m_libraryTrees) {
+        if (!rootNode) {
+            continue;
+        }
         for (ASTNode node : rootNode->getChildren()) {
             if (node->getNodeType() == AST::Declaration) {
                 std::shared_ptr<DeclarationNode> block = static_pointer_cast<DeclarationNode>(node);
@@ -121,6 +132,9 @@ std::vector<ASTNode> StrideLibrary::getLibraryMembers()
 {
     std::vector<ASTNode> nodes;
     for (ASTNode tree :m_libraryTrees) {
+        if (!tree) {
+            continue;
+        }
         for(ASTNode node : tree->getChildren()) {
             nodes.push_back(node);
         }
@@ -171,7 +185,7 @@ QList<DeclarationNode *> StrideLibrary::getParentTypes(DeclarationNode *type)
     return QList<DeclarationNode *>();
 }
 
-void StrideLibrary::readLibrary(QString rootDir, QMap<QString, QString> importList)
+void StrideLibrary::readLibrary(QString rootDir, QMap<QString, QString> importList, bool lazy)
 {
     QStringList nameFilters;
     nameFilters << "*.stride";
@@ -187,6 +201,11 @@ void StrideLibrary::readLibrary(QString rootDir, QMap<QString, QString> importLi
         QStringList libraryFiles =  QDir(rootDir + basepath + QDir::separator() + subPath).entryList(nameFilters);
         foreach (QString file, libraryFiles) {
             QString fileName = rootDir + basepath + QDir::separator() + subPath + QDir::separator() + file;
+            m_libraryFiles << fileName;
+            if (lazy) {
+                m_libraryTrees.append(nullptr);
+                continue;
+            }
             ASTNode tree = AST::parseFile(fileName.toLocal8Bit().data(), nullptr);
             if(tree) {
                 QString namespaceName = importList[subPath];
@@ -196,7 +215,6 @@ void StrideLibrary::readLibrary(QString rootDir, QMap<QString, QString> importLi
 //                        node->setNamespace(namespaceName.toStdString());
                     }
                 }
-                m_libraryTrees.append(tree);
             } else {
                 qDebug() << "Not loaded:" << fileName;
                 vector<LangError> errors = AST::getParseErrors();
@@ -204,6 +222,7 @@ void StrideLibrary::readLibrary(QString rootDir, QMap<QString, QString> importLi
                     qDebug() << QString::fromStdString(error.getErrorText());
                 }
             }
+            m_libraryTrees.append(tree);
         }
     }
 }
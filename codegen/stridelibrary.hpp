@@ -38,6 +38,7 @@
 #include <vector>
 
 #include <QString>
+#include <QStringList>
 #include <QList>
 #include <QMap>
 
@@ -51,7 +52,12 @@ public:
     StrideLibrary(QString libraryPath, QMap<QString,QString> importList = QMap<QString,QString>());
    ~StrideLibrary();
 
-    void setLibraryPath(QString strideRootPath, QMap<QString,QString> importList = QMap<QString,QString>());
+    /// If lazy is set, library files are only listed. They are parsed by the
+    /// caller and handed over with setFileTree() when needed.
+    void setLibraryPath(QString strideRootPath, QMap<QString,QString> importList = QMap<QString,QString>(),
+                        bool lazy = false);
+    QStringList getLibraryFiles() const { return m_libraryFiles; }
+    void setFileTree(int index, ASTNode tree);
 
     std::shared_ptr<DeclarationNode> findTypeInLibrary(QString typeName);
 
@@ -64,8 +70,9 @@ private:
     bool isValidProperty(std::shared_ptr<PropertyNode> property, DeclarationNode *type);
     QList<DeclarationNode *> getParentTypes(DeclarationNode *type);
 
-    void readLibrary(QString rootDir, QMap<QString, QString> importList);
-    QList<ASTNode> m_libraryTrees;
+    void readLibrary(QString rootDir, QMap<QString, QString> importList, bool lazy = false);
+    QStringList m_libraryFiles;
+    QList<ASTNode> m_libraryTrees; // One for each file in m_libraryFiles. nullptr if not loaded
     int m_majorVersion;
     int m_minorVersion;
 };
@@ -38,6 +38,7 @@
 #include <QFile>
 #include <QTextStream>
 #include <QDebug>
+#include <QMutexLocker>
 
 #include "stridesystem.hpp"
 
@@ -45,6 +46,7 @@
 #include "declarationnode.h"
 #include "pythonproject.h"
 #include "codevalidator.h"
+#include "symbolmanifest.hpp"
 
 
 StrideSystem::StrideSystem(QString strideRoot, QString systemName,
@@ -60,7 +62,15 @@ StrideSystem::StrideSystem(QString strideRoot, QString systemName,
                             + versionString).absolutePath();
     QString systemFile = m_systemPath + QDir::separator() + "System.stride";
 
-    m_library.setLibraryPath(strideRoot, importList);
+    m_library.setLibraryPath(strideRoot, importList, true);
+    QStringList libraryFileNames = m_library.getLibraryFiles();
+    for (int i = 0; i < libraryFileNames.size(); i++) {
+        SourceFile sourceFile;
+        sourceFile.fileName = libraryFileNames.at(i);
+        sourceFile.libraryIndex = i;
+        sourceFile.loaded = false;
+        m_sourceFiles.push_back(sourceFile);
+    }
     if (QFile::exists(systemFile)) {
         ASTNode systemTree = AST::parseFile(systemFile.toStdString().c_str(), nullptr);
         if (systemTree) {
@@ -84,24 +94,12 @@ StrideSystem::StrideSystem(QString strideRoot, QString systemName,
                     QString includeSubPath = QString::fromStdString(platformPath + "/" + subPath);
                     QStringList libraryFiles =  QDir(includeSubPath).entryList(nameFilters);
                     foreach (QString file, libraryFiles) {
-                        QString fileName = includeSubPath + QDir::separator() + file;
-                        ASTNode tree = AST::parseFile(fileName.toLocal8Bit().data(), nullptr);
-                        if(tree) {
-                            platform->addTree(file.toStdString(),tree);
-                        } else {
-                            vector<LangError> errors = AST::getParseErrors();
-                            foreach(LangError error, errors) {
-                                qDebug() << QString::fromStdString(error.getErrorText());
-                            }
-                            continue;
-                        }
-                        QString namespaceName = importList[QString::fromStdString(subPath)];
-                        if (!namespaceName.isEmpty()) {
-                            for(ASTNode node : tree->getChildren()) {
-                                // Do we need to set namespace recursively or would this do?
-                                //                            node->setNamespace(namespaceName.toStdString());
-                            }
-                        }
+                        SourceFile sourceFile;
+                        sourceFile.fileName = includeSubPath + QDir::separator() + file;
+                        sourceFile.platform = platform;
+                        sourceFile.libraryIndex = -1;
+                        sourceFile.loaded = false;
+                        m_sourceFiles.push_back(sourceFile);
                     }
                 }
 //                m_platformPath = fullPath;
@@ -131,6 +129,10 @@ StrideSystem::StrideSystem(QString strideRoot, QString systemName,
 //                m_platformPath = fullPath;
 //                m_api = PythonTools;
 //                m_types = getPlatformTypeNames();
+
+            // Load the files that are always needed. The rest wait for loadDependencies()
+            loadNames(std::set<std::string>());
+            SymbolManifest::instance()->save();
         } else {
             qDebug() << "Error parsing system tree in:" << systemFile;
         }
@@ -284,6 +286,7 @@ QStringList StrideSystem::getWarnings()
 
 QStringList StrideSystem::getPlatformTypeNames()
 {
+    loadAllFiles();
     QStringList typeNames;
 //    foreach(AST* group, m_platform) {
 //        foreach(AST *node, group->getChildren()) {
@@ -319,6 +322,7 @@ QStringList StrideSystem::getPlatformTypeNames()
 
 QStringList StrideSystem::getFunctionNames()
 {
+    loadAllFiles();
     QStringList funcNames;
 
     map<string, vector<ASTNode>> refObjects = getBuiltinObjectsReference();
@@ -513,3 +517,92 @@ QString StrideSystem::makeProject(QString fileName)
     }
     return dirName;
 }
+
+void StrideSystem::loadDependencies(ASTNode tree)
+{
+    std::set<std::string> names;
+    SymbolManifest::collectNames(tree, names);
+    QMutexLocker locker(&m_loadMutex);
+    loadNames(names);
+    SymbolManifest::instance()->save();
+}
+
+void StrideSystem::loadAllFiles()
+{
+    QMutexLocker locker(&m_loadMutex);
+    for (SourceFile &sourceFile: m_sourceFiles) {
+        if (!sourceFile.loaded) {
+            loadSourceFile(sourceFile, nullptr);
+        }
+    }
+}
+
+int StrideSystem::loadedFileCount()
+{
+    QMutexLocker locker(&m_loadMutex);
+    int count = 0;
+    for (SourceFile &sourceFile: m_sourceFiles) {
+        if (sourceFile.loaded) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void StrideSystem::loadSourceFile(StrideSystem::SourceFile &file, ASTNode tree)
+{
+    if (!tree) {
+        tree = AST::parseFile(file.fileName.toLocal8Bit().data(), nullptr);
+        if (!tree) {
+            qDebug() << "Not loaded:" << file.fileName;
+            vector<LangError> errors = AST::getParseErrors();
+            foreach(LangError error, errors) {
+                qDebug() << QString::fromStdString(error.getErrorText());
+            }
+            return;
+        }
+    }
+    if (file.platform) {
+        file.platform->addTree(QFileInfo(file.fileName).fileName().toStdString(), tree);
+    } else {
+        m_library.setFileTree(file.libraryIndex, tree);
+    }
+    file.loaded = true;
+}
+
+void StrideSystem::loadNames(std::set<string> names)
+{
+    // Load every file that declares a required name, then what those files
+    // refer to, until nothing new is needed.
+    m_requiredNames.insert(names.begin(), names.end());
+    SymbolManifest *manifest = SymbolManifest::instance();
+    bool newNames;
+    do {
+        newNames = false;
+        for (SourceFile &sourceFile: m_sourceFiles) {
+            if (sourceFile.loaded) {
+                continue;
+            }
+            SymbolManifest::Entry entry;
+            ASTNode tree;
+            if (!manifest->getEntry(sourceFile.fileName, entry, tree)) {
+                continue;
+            }
+            bool needed = entry.always;
+            for (std::string name: entry.declares) {
+                if (m_requiredNames.find(name) != m_requiredNames.end()) {
+                    needed = true;
+                    break;
+                }
+            }
+            if (needed) {
+                loadSourceFile(sourceFile, tree);
+                for (std::string name: entry.references) {
+                    if (m_requiredNames.insert(name).second) {
+                        newNames = true;
+                    }
+                }
+            }
+        }
+    } while (newNames);
+}
@@ -42,6 +42,9 @@
 #include <QMap>
 #include <QFileInfo>
 #include <QDir>
+#include <QMutex>
+
+#include <set>
 
 #include "strideparser.h"
 #include "stridelibrary.hpp"
@@ -78,7 +81,25 @@ public:
 
     vector<ASTNode> getOptionTrees();
 
+    /// Library and platform files are parsed on demand. Files holding types,
+    /// domains and framework descriptions are loaded with the system; other
+    /// files are loaded when a tree refers to what they declare. Loading uses
+    /// the parser, so it must not run concurrently with other parsing.
+    void loadDependencies(ASTNode tree);
+    void loadAllFiles(); // For listing everything available, e.g. for autocompletion
+    int loadedFileCount();
+
 private:
+    typedef struct {
+        QString fileName;
+        std::shared_ptr<StridePlatform> platform; // nullptr for library files
+        int libraryIndex;
+        bool loaded;
+    } SourceFile;
+
+    void loadSourceFile(SourceFile &file, ASTNode tree);
+    void loadNames(std::set<std::string> names);
+
     QVector<ASTNode> getPortsForTypeBlock(DeclarationNode *block);
 //    ListNode *getPortsForFunction(QString typeName);
 
@@ -106,6 +127,10 @@ private:
 
     QMap<QString, QString> m_importList;
     StrideLibrary m_library;
+
+    vector<SourceFile> m_sourceFiles;
+    std::set<std::string> m_requiredNames; // Names referenced by the program and by loaded files
+    QMutex m_loadMutex;
 };
 
 
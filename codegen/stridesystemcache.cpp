@@ -0,0 +1,90 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <QMutexLocker>
+
+#include "stridesystemcache.hpp"
+#include "importnode.h"
+#include "platformnode.h"
+
+StrideSystemCache::StrideSystemCache(QString strideRoot) :
+    m_strideRoot(strideRoot)
+{
+}
+
+std::shared_ptr<StrideSystem> StrideSystemCache::getSystem(ASTNode tree)
+{
+    QMap<QString, QString> importList;
+    std::shared_ptr<SystemNode> systemNode;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() == AST::Import) {
+            std::shared_ptr<ImportNode> import = static_pointer_cast<ImportNode>(node);
+            importList[QString::fromStdString(import->importName())] =
+                    QString::fromStdString(import->importAlias());
+        } else if (node->getNodeType() == AST::Platform && !systemNode) {
+            systemNode = static_pointer_cast<SystemNode>(node);
+        }
+    }
+    QString systemName;
+    int majorVersion = -1;
+    int minorVersion = -1;
+    if (systemNode) {
+        systemName = QString::fromStdString(systemNode->platformName());
+        majorVersion = systemNode->majorVersion();
+        minorVersion = systemNode->minorVersion();
+    }
+    QString key = QString("%1 %2.%3").arg(systemName).arg(majorVersion).arg(minorVersion);
+    for (auto it = importList.constBegin(); it != importList.constEnd(); ++it) {
+        key += " " + it.key() + ":" + it.value();
+    }
+    QMutexLocker locker(&m_mutex);
+    if (!m_systems.contains(key)) {
+        m_systems[key] = std::make_shared<StrideSystem>(m_strideRoot,
+                                                        systemName, majorVersion, minorVersion,
+                                                        importList);
+    }
+    return m_systems[key];
+}
+
+void StrideSystemCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_systems.clear();
+}
+
+int StrideSystemCache::size()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_systems.size();
+}
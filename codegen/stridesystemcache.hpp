@@ -0,0 +1,66 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef STRIDESYSTEMCACHE_HPP
+#define STRIDESYSTEMCACHE_HPP
+
+#include <memory>
+
+#include <QString>
+#include <QMap>
+#include <QMutex>
+
+#include "ast.h"
+#include "stridesystem.hpp"
+
+/// Loads each system once per name, version and imports so it can be shared by
+/// many trees (see the CodeValidator constructor that takes a system).
+/// getSystem() can be called from several threads, but loading a system uses
+/// the parser, so it must not run concurrently with other parsing.
+class StrideSystemCache
+{
+public:
+    StrideSystemCache(QString strideRoot);
+
+    std::shared_ptr<StrideSystem> getSystem(ASTNode tree);
+    void clear(); // Systems are reloaded from disk on next use
+    int size();
+
+private:
+    QString m_strideRoot;
+    QMutex m_mutex;
+    QMap<QString, std::shared_ptr<StrideSystem>> m_systems;
+};
+
+#endif // STRIDESYSTEMCACHE_HPP
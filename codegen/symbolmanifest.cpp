@@ -0,0 +1,246 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMutexLocker>
+#include <QDebug>
+
+#include "symbolmanifest.hpp"
+
+#include "blocknode.h"
+#include "bundlenode.h"
+#include "declarationnode.h"
+#include "functionnode.h"
+#include "valuenode.h"
+#include "portpropertynode.h"
+
+#define SYMBOL_MANIFEST_VERSION 1
+
+SymbolManifest *SymbolManifest::instance()
+{
+    static SymbolManifest manifest;
+    return &manifest;
+}
+
+void SymbolManifest::setCacheDirectory(QString directory)
+{
+    cacheDirectory() = directory;
+}
+
+QString &SymbolManifest::cacheDirectory()
+{
+    static QString directory;
+    return directory;
+}
+
+SymbolManifest::SymbolManifest() :
+    m_modified(false)
+{
+    QString cacheDir = cacheDirectory();
+    if (cacheDir.isEmpty()) {
+        cacheDir = qgetenv("STRIDE_BUILD_CACHE");
+    }
+    if (cacheDir.isEmpty()) {
+        cacheDir = QDir::homePath() + "/.stride/cache";
+    }
+    m_manifestFile = cacheDir + "/symbols.json";
+    load();
+}
+
+bool SymbolManifest::getEntry(QString fileName, SymbolManifest::Entry &entry, ASTNode &parsedTree)
+{
+    QFileInfo info(fileName);
+    QString key = info.absoluteFilePath();
+    qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    parsedTree = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.constFind(key);
+        if (it != m_entries.constEnd() && it->size == info.size() && it->modified == modified) {
+            entry = it.value();
+            return true;
+        }
+    }
+    parsedTree = AST::parseFile(fileName.toLocal8Bit().data(), nullptr);
+    if (!parsedTree) {
+        qDebug() << "Not loaded:" << fileName;
+        vector<LangError> errors = AST::getParseErrors();
+        foreach(LangError error, errors) {
+            qDebug() << QString::fromStdString(error.getErrorText());
+        }
+        return false;
+    }
+    entry = describeTree(parsedTree);
+    entry.size = info.size();
+    entry.modified = modified;
+    QMutexLocker locker(&m_mutex);
+    m_entries[key] = entry;
+    m_modified = true;
+    return true;
+}
+
+void SymbolManifest::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_modified) {
+        return;
+    }
+    QJsonObject files;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        QJsonObject entry;
+        entry["size"] = it->size;
+        entry["modified"] = it->modified;
+        entry["always"] = it->always;
+        QJsonArray declares, references;
+        for (std::string name: it->declares) {
+            declares.append(QString::fromStdString(name));
+        }
+        for (std::string name: it->references) {
+            references.append(QString::fromStdString(name));
+        }
+        entry["declares"] = declares;
+        entry["references"] = references;
+        files[it.key()] = entry;
+    }
+    QJsonObject manifest;
+    manifest["version"] = SYMBOL_MANIFEST_VERSION;
+    manifest["files"] = files;
+
+    QDir().mkpath(QFileInfo(m_manifestFile).absolutePath());
+    QSaveFile file(m_manifestFile); // Written to a temporary file and renamed, so readers never see half a manifest
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(manifest).toJson(QJsonDocument::Compact));
+        if (file.commit()) {
+            m_modified = false;
+        }
+    } else {
+        qDebug() << "Can't write symbol manifest:" << m_manifestFile;
+    }
+}
+
+void SymbolManifest::collectNames(ASTNode node, std::set<std::string> &names)
+{
+    switch (node->getNodeType()) {
+    case AST::Block:
+        names.insert(static_cast<BlockNode *>(node.get())->getName());
+        break;
+    case AST::Bundle:
+        names.insert(static_cast<BundleNode *>(node.get())->getName());
+        break;
+    case AST::Function:
+        names.insert(static_cast<FunctionNode *>(node.get())->getName());
+        break;
+    case AST::Declaration:
+    case AST::BundleDeclaration:
+        names.insert(static_cast<DeclarationNode *>(node.get())->getObjectType());
+        break;
+    case AST::String:
+        // Domains, inherited types and type names are referred to by strings
+        names.insert(static_cast<ValueNode *>(node.get())->getStringValue());
+        break;
+    case AST::PortProperty:
+        names.insert(static_cast<PortPropertyNode *>(node.get())->getName());
+        break;
+    default:
+        break;
+    }
+    for (ASTNode child: node->getChildren()) {
+        if (child) {
+            collectNames(child, names);
+        }
+    }
+}
+
+void SymbolManifest::load()
+{
+    QFile file(m_manifestFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QJsonObject manifest = QJsonDocument::fromJson(file.readAll()).object();
+    if (manifest["version"].toInt() != SYMBOL_MANIFEST_VERSION) {
+        return;
+    }
+    QJsonObject files = manifest["files"].toObject();
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+        QJsonObject object = it.value().toObject();
+        Entry entry;
+        entry.size = (qint64) object["size"].toDouble();
+        entry.modified = (qint64) object["modified"].toDouble();
+        entry.always = object["always"].toBool();
+        for (QJsonValue name: object["declares"].toArray()) {
+            entry.declares.insert(name.toString().toStdString());
+        }
+        for (QJsonValue name: object["references"].toArray()) {
+            entry.references.insert(name.toString().toStdString());
+        }
+        m_entries[it.key()] = entry;
+    }
+}
+
+SymbolManifest::Entry SymbolManifest::describeTree(ASTNode tree)
+{
+    Entry entry;
+    entry.always = false;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() == AST::Declaration || node->getNodeType() == AST::BundleDeclaration) {
+            std::shared_ptr<DeclarationNode> decl = static_pointer_cast<DeclarationNode>(node);
+            std::string objectType = decl->getObjectType();
+            entry.declares.insert(decl->getName());
+            if (objectType == "type" || objectType == "platformType") {
+                ASTNode typeName = decl->getPropertyValue("typeName");
+                if (typeName && typeName->getNodeType() == AST::String) {
+                    entry.declares.insert(static_cast<ValueNode *>(typeName.get())->getStringValue());
+                }
+                entry.always = true; // Types are looked up by type name and through inheritance
+            } else if (objectType == "_domainDefinition" || objectType == "_frameworkDescription") {
+                entry.always = true;
+            } else if (objectType == "constant"
+                       && (decl->getName() == "PlatformDomain" || decl->getName() == "PlatformRate")) {
+                entry.always = true;
+            }
+        } else {
+            entry.always = true; // Anything other than a declaration is not looked up by name
+        }
+        collectNames(node, entry.references);
+    }
+    return entry;
+}
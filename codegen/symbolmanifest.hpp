@@ -0,0 +1,89 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef SYMBOLMANIFEST_HPP
+#define SYMBOLMANIFEST_HPP
+
+#include <set>
+#include <string>
+
+#include <QString>
+#include <QMap>
+#include <QMutex>
+
+#include "ast.h"
+
+/// Records what each library and platform file declares and references so a
+/// system can parse only the files a program needs. Entries are checked
+/// against the file's size and modification time and stored in symbols.json
+/// in the build cache directory (the BuildCacheDir setting, or ~/.stride/cache
+/// unless STRIDE_BUILD_CACHE is set), shared by all processes.
+class SymbolManifest
+{
+public:
+    typedef struct {
+        qint64 size;
+        qint64 modified;
+        std::set<std::string> declares;
+        std::set<std::string> references;
+        bool always; // Holds types, domains or framework descriptions. Must always be loaded
+    } Entry;
+
+    static SymbolManifest *instance();
+    /// Uses the same directory as the generator's build cache. Must be called
+    /// before instance() is first used.
+    static void setCacheDirectory(QString directory);
+
+    /// Returns false if the file can't be parsed. If the entry had to be
+    /// updated, the tree parsed for it is returned in parsedTree.
+    bool getEntry(QString fileName, Entry &entry, ASTNode &parsedTree);
+    void save(); // Writes the manifest if any entries changed
+
+    static void collectNames(ASTNode node, std::set<std::string> &names);
+
+private:
+    SymbolManifest();
+
+    void load();
+    Entry describeTree(ASTNode tree);
+
+    static QString &cacheDirectory();
+
+    QString m_manifestFile;
+    QMap<QString, Entry> m_entries;
+    bool m_modified;
+    QMutex m_mutex;
+};
+
+#endif // SYMBOLMANIFEST_HPP
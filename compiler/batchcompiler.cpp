@@ -0,0 +1,212 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <iostream>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "batchcompiler.hpp"
+
+class BatchCompileTask : public QRunnable
+{
+public:
+    BatchCompileTask(BatchCompiler *compiler, size_t index, StrideCompiler::Program program) :
+        m_compiler(compiler), m_index(index), m_program(program) {}
+
+    void run() override {
+        m_compiler->build(m_index, m_program);
+    }
+
+private:
+    BatchCompiler *m_compiler;
+    size_t m_index;
+    StrideCompiler::Program m_program;
+};
+
+BatchCompiler::BatchCompiler(QString strideRoot, QMap<QString, QVariant> configuration, int maxJobs) :
+    m_compiler(strideRoot),
+    m_configuration(configuration),
+    m_maxJobs(maxJobs),
+    m_totalElapsed(0)
+{
+}
+
+void BatchCompiler::addSource(QString fileName)
+{
+    QString absoluteName = QFileInfo(fileName).absoluteFilePath();
+    for (auto result: m_results) {
+        if (result.fileName == absoluteName) {
+            return; // Same products directory, so build only once
+        }
+    }
+    Result result;
+    result.fileName = absoluteName;
+    result.success = false;
+    result.elapsedMs = 0;
+    m_results.push_back(result);
+}
+
+bool BatchCompiler::addManifest(QString manifestFile)
+{
+    QFile file(manifestFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+    QDir manifestDir = QFileInfo(manifestFile).absoluteDir();
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        int comment = line.indexOf('#');
+        if (comment >= 0) {
+            line = line.left(comment);
+        }
+        line = line.trimmed();
+        if (!line.isEmpty()) {
+            addSource(manifestDir.absoluteFilePath(line));
+        }
+    }
+    return true;
+}
+
+bool BatchCompiler::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Parsing and validation share global parser state, so do them here
+    std::vector<StrideCompiler::Program> programs(m_results.size());
+    QThreadPool pool;
+    if (m_maxJobs > 0) {
+        pool.setMaxThreadCount(m_maxJobs);
+    }
+    for (size_t i = 0; i < m_results.size(); i++) {
+        Result &result = m_results[i];
+        QElapsedTimer prepareTimer;
+        prepareTimer.start();
+        programs[i].fileName = result.fileName;
+        if (!QFile::exists(result.fileName)) {
+            result.message = "File not found";
+        } else if (m_compiler.prepare(programs[i])) {
+            result.elapsedMs = prepareTimer.elapsed();
+            // Start building while the rest are prepared
+            pool.start(new BatchCompileTask(this, i, programs[i]));
+            continue;
+        } else if (programs[i].errors.size() > 0) {
+            result.message = QString::fromStdString(programs[i].errors.first().getErrorText());
+        } else {
+            result.message = "Parse failed";
+        }
+        result.elapsedMs = prepareTimer.elapsed();
+        printResult(result);
+    }
+    pool.waitForDone();
+    m_totalElapsed = timer.elapsed();
+
+    std::cerr << m_results.size() - failedCount() << "/" << m_results.size()
+              << " programs built in " << m_totalElapsed << " ms ("
+              << m_compiler.cachedSystems() << " systems loaded)" << std::endl;
+    return failedCount() == 0;
+}
+
+int BatchCompiler::failedCount() const
+{
+    int count = 0;
+    for (auto result: m_results) {
+        if (!result.success) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool BatchCompiler::writeReport(QString fileName) const
+{
+    QJsonArray programs;
+    for (auto result: m_results) {
+        QJsonObject program;
+        program["file"] = result.fileName;
+        program["success"] = result.success;
+        program["message"] = result.message;
+        program["elapsedMs"] = result.elapsedMs;
+        programs.append(program);
+    }
+    QJsonObject report;
+    report["programs"] = programs;
+    report["total"] = (int) m_results.size();
+    report["failed"] = failedCount();
+    report["elapsedMs"] = m_totalElapsed;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(report).toJson());
+    return true;
+}
+
+void BatchCompiler::build(size_t index, StrideCompiler::Program program)
+{
+    Result &result = m_results[index];
+    QElapsedTimer timer;
+    timer.start();
+    result.success = m_compiler.build(program, m_configuration);
+    if (!result.success) {
+        result.message = program.stdErr.trimmed();
+        if (result.message.isEmpty()) {
+            result.message = "Build failed";
+        }
+    }
+    result.elapsedMs += timer.elapsed();
+    printResult(result);
+}
+
+void BatchCompiler::printResult(const Result &result)
+{
+    QMutexLocker locker(&m_printMutex);
+    std::cerr << (result.success ? "OK     " : "FAILED ") << result.fileName.toStdString()
+              << " (" << result.elapsedMs << " ms)";
+    if (!result.success) {
+        std::cerr << ": " << result.message.toStdString();
+    }
+    std::cerr << std::endl;
+}
@@ -0,0 +1,87 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef BATCHCOMPILER_HPP
+#define BATCHCOMPILER_HPP
+
+#include <vector>
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QVariant>
+#include <QMutex>
+
+#include "stridecompiler.hpp"
+
+/// Compiles many Stride programs in one invocation. Programs are parsed and
+/// validated serially against systems loaded once, then built concurrently
+/// in a thread pool. Each program keeps its own tree and products directory.
+class BatchCompiler
+{
+public:
+    typedef struct {
+        QString fileName;
+        bool success;
+        QString message;
+        qint64 elapsedMs;
+    } Result;
+
+    BatchCompiler(QString strideRoot, QMap<QString, QVariant> configuration = QMap<QString, QVariant>(),
+                  int maxJobs = 0);
+
+    void addSource(QString fileName);
+    bool addManifest(QString manifestFile); // One source per line, relative to the manifest. '#' starts a comment
+
+    bool run(); // Returns true if all programs built
+
+    std::vector<Result> getResults() const { return m_results; }
+    int failedCount() const;
+    bool writeReport(QString fileName) const;
+
+private:
+    void build(size_t index, StrideCompiler::Program program);
+    void printResult(const Result &result);
+
+    friend class BatchCompileTask;
+
+    StrideCompiler m_compiler;
+    QMap<QString, QVariant> m_configuration;
+    int m_maxJobs;
+    std::vector<Result> m_results;
+    QMutex m_printMutex;
+    qint64 m_totalElapsed;
+};
+
+#endif // BATCHCOMPILER_HPP
@@ -0,0 +1,193 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <iostream>
+#include <iomanip>
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QRegularExpression>
+
+#include "codevalidator.h"
+
+#include "benchmarkrunner.hpp"
+
+BenchmarkRunner::BenchmarkRunner(QString strideRoot, QMap<QString, QVariant> configuration) :
+    m_strideRoot(strideRoot), m_configuration(configuration)
+{
+    m_configuration["Benchmark"] = true;
+}
+
+bool BenchmarkRunner::benchmark(QString fileName)
+{
+    ASTNode tree = AST::parseFile(fileName.toLocal8Bit().constData());
+    if (!tree) {
+        for (LangError error: AST::getParseErrors()) {
+            qDebug() << QString::fromStdString(error.getErrorText());
+        }
+        return false;
+    }
+    CodeValidator validator(m_strideRoot, tree,
+                            CodeValidator::Options(CodeValidator::USE_TESTING | CodeValidator::OPTIMIZE));
+    if (!validator.isValid()) {
+        for (LangError error: validator.getErrors()) {
+            qDebug() << QString::fromStdString(error.getErrorText());
+        }
+        return false;
+    }
+    std::shared_ptr<StrideSystem> system = validator.getSystem();
+    std::vector<std::string> usedFrameworks;
+    for (string domain: CodeValidator::getUsedDomains(tree)) {
+        usedFrameworks.push_back(CodeValidator::getFrameworkForDomain(domain, tree));
+    }
+    vector<Builder *> builders = system->createBuilders(fileName, usedFrameworks);
+    if (builders.size() == 0) {
+        qDebug() << "Can't create builder for" << fileName;
+        return false;
+    }
+    bool benchmarkOK = true;
+    for (auto builder: builders) {
+        builder->setConfiguration(m_configuration);
+        if (!builder->build(tree) || !builder->run()) {
+            qDebug() << "Benchmark build/run failed for" << fileName;
+            qDebug() << builder->getStdErr();
+            benchmarkOK = false;
+            continue;
+        }
+        // The generated program prints one line per domain
+        QRegularExpression resultExpression("STRIDE_BENCHMARK (\\{[^}]*\\})");
+        QRegularExpressionMatchIterator matches = resultExpression.globalMatch(builder->getStdOut());
+        bool found = false;
+        while (matches.hasNext()) {
+            QJsonDocument doc = QJsonDocument::fromJson(matches.next().captured(1).toUtf8());
+            if (doc.isObject()) {
+                QJsonObject result = doc.object();
+                result["file"] = QDir::current().relativeFilePath(QFileInfo(fileName).absoluteFilePath());
+                result["framework"] = builder->getPlatformPath();
+                m_results.append(result);
+                std::cout << fileName.toStdString() << " " << result["domain"].toString().toStdString()
+                          << ": " << result["ns_per_sample"].toDouble() << " ns/sample "
+                          << result["cycles_per_sample"].toDouble() << " cycles/sample" << std::endl;
+                found = true;
+            }
+        }
+        if (!found) {
+            qDebug() << "No benchmark results for" << fileName;
+            benchmarkOK = false;
+        }
+    }
+    for (auto builder: builders) {
+        delete builder;
+    }
+    return benchmarkOK;
+}
+
+bool BenchmarkRunner::writeResults(QString fileName) const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Can't write benchmark results to" << fileName;
+        return false;
+    }
+    file.write(QJsonDocument(m_results).toJson());
+    return true;
+}
+
+int BenchmarkRunner::compareToBaseline(QString baselineFile, double tolerance)
+{
+    QFile file(baselineFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Can't open baseline" << baselineFile;
+        return -1;
+    }
+    QMap<QString, QJsonObject> baseline;
+    for (QJsonValue value: QJsonDocument::fromJson(file.readAll()).array()) {
+        baseline[resultKey(value.toObject())] = value.toObject();
+    }
+    int regressions = 0;
+    for (QJsonValue value: m_results) {
+        QJsonObject result = value.toObject();
+        QString key = resultKey(result);
+        if (!baseline.contains(key)) {
+            std::cout << "NEW  " << key.toStdString() << std::endl;
+            continue;
+        }
+        double before = baseline[key]["ns_per_sample"].toDouble();
+        double now = result["ns_per_sample"].toDouble();
+        double change = before > 0 ? 100.0 * (now - before) / before : 0.0;
+        bool regressed = change > tolerance;
+        if (regressed) {
+            regressions++;
+        }
+        std::cout << (regressed ? "SLOW " : "OK   ") << key.toStdString() << ": "
+                  << before << " -> " << now << " ns/sample ("
+                  << std::showpos << std::fixed << std::setprecision(1) << change << "%)"
+                  << std::noshowpos << std::defaultfloat << std::endl;
+    }
+    return regressions;
+}
+
+QStringList BenchmarkRunner::findSources(QStringList paths)
+{
+    QStringList sources;
+    for (QString path: paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QStringList dirSources;
+            QDirIterator it(path, QStringList() << "*.stride", QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                QString source = it.next();
+                if (!source.contains("_Products")) {
+                    dirSources << source;
+                }
+            }
+            dirSources.sort();
+            sources << dirSources;
+        } else {
+            sources << path;
+        }
+    }
+    return sources;
+}
+
+QString BenchmarkRunner::resultKey(QJsonObject result)
+{
+    return QString("%1 %2 %3").arg(result["file"].toString())
+            .arg(result["domain"].toString())
+            .arg(result["block_size"].toInt());
+}
@@ -0,0 +1,70 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef BENCHMARKRUNNER_HPP
+#define BENCHMARKRUNNER_HPP
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QVariant>
+#include <QJsonArray>
+#include <QJsonObject>
+
+/// Builds Stride programs against the testing domain in benchmark mode, runs
+/// them and collects the timing reported by the generated code.
+class BenchmarkRunner
+{
+public:
+    BenchmarkRunner(QString strideRoot, QMap<QString, QVariant> configuration = QMap<QString, QVariant>());
+
+    bool benchmark(QString fileName);
+    QJsonArray getResults() const { return m_results; }
+    bool writeResults(QString fileName) const;
+
+    /// Compare results to a file previously written by writeResults().
+    /// Returns the number of results slower than baseline by more than tolerance percent.
+    int compareToBaseline(QString baselineFile, double tolerance);
+
+    static QStringList findSources(QStringList paths); // Expands directories to the .stride files they contain
+
+private:
+    static QString resultKey(QJsonObject result);
+
+    QString m_strideRoot;
+    QMap<QString, QVariant> m_configuration;
+    QJsonArray m_results;
+};
+
+#endif // BENCHMARKRUNNER_HPP
@@ -1,4 +1,4 @@
-QT += core
+QT += core network
 QT -= gui
 
 CONFIG += c++11
@@ -9,7 +9,17 @@ CONFIG -= app_bundle
 
 TEMPLATE = app
 
-SOURCES += main.cpp
+SOURCES += main.cpp \
+    benchmarkrunner.cpp \
+    stridecompiler.cpp \
+    compileserver.cpp \
+    batchcompiler.cpp
+
+HEADERS += \
+    benchmarkrunner.hpp \
+    stridecompiler.hpp \
+    compileserver.hpp \
+    batchcompiler.hpp
 
 
 INCLUDEPATH += $$PWD/../parser
@@ -0,0 +1,191 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+
+#include "compileserver.hpp"
+
+CompileServer::CompileServer(QString strideRoot, QMap<QString, QVariant> configuration,
+                             QObject *parent) :
+    QObject(parent),
+    m_server(this),
+    m_compiler(strideRoot),
+    m_configuration(configuration),
+    m_busy(false)
+{
+    m_compiler.setIncremental(true); // Clients send the same files again and again
+    connect(&m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+bool CompileServer::listen(QString name)
+{
+    QLocalServer::removeServer(name); // Remove stale socket left by a crashed server
+    return m_server.listen(name);
+}
+
+void CompileServer::newConnection()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequests()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void CompileServer::readRequests()
+{
+    QLocalSocket *socket = qobject_cast<QLocalSocket *>(sender());
+    if (!socket) {
+        return;
+    }
+    while (socket->canReadLine()) {
+        QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError parseError;
+        QJsonDocument document = QJsonDocument::fromJson(line, &parseError);
+        if (!document.isObject()) {
+            QJsonObject reply;
+            reply["type"] = QString("result");
+            reply["success"] = false;
+            reply["message"] = "Invalid request: " + parseError.errorString();
+            send(socket, reply);
+            continue;
+        }
+        m_queue.append(qMakePair(QPointer<QLocalSocket>(socket), document.object()));
+    }
+    // Builds process events while waiting, so requests are queued and
+    // handled one at a time
+    if (!m_busy) {
+        QTimer::singleShot(0, this, SLOT(processQueue()));
+    }
+}
+
+void CompileServer::processQueue()
+{
+    if (m_busy) {
+        return;
+    }
+    m_busy = true;
+    while (!m_queue.isEmpty()) {
+        QPair<QPointer<QLocalSocket>, QJsonObject> request = m_queue.takeFirst();
+        if (request.first) {
+            handleRequest(request.first, request.second);
+        }
+    }
+    m_busy = false;
+}
+
+void CompileServer::handleRequest(QLocalSocket *socket, QJsonObject request)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QPointer<QLocalSocket> output(socket); // The client can go away while building
+    QString command = request.value("command").toString("compile");
+    QJsonObject result;
+    result["type"] = QString("result");
+    if (request.contains("id")) {
+        result["id"] = request["id"];
+    }
+
+    if (command == "shutdown") {
+        result["success"] = true;
+        send(socket, result);
+        QCoreApplication::quit();
+        return;
+    } else if (command == "reload") {
+        m_compiler.clearCache();
+        result["success"] = true;
+        send(socket, result);
+        return;
+    } else if (command != "compile" && command != "check") {
+        result["success"] = false;
+        result["message"] = "Unknown command: " + command;
+        send(socket, result);
+        return;
+    }
+
+    StrideCompiler::Program program;
+    program.fileName = QDir::current().absoluteFilePath(request.value("file").toString());
+    bool success = m_compiler.prepare(program, request.value("source").toString());
+    for (LangError error: program.errors) {
+        QJsonObject diagnostic;
+        if (request.contains("id")) {
+            diagnostic["id"] = request["id"];
+        }
+        diagnostic["type"] = QString("diagnostic");
+        diagnostic["file"] = QString::fromStdString(error.filename);
+        diagnostic["line"] = error.lineNumber;
+        diagnostic["code"] = (int) error.type;
+        diagnostic["message"] = QString::fromStdString(error.getErrorText());
+        send(socket, diagnostic);
+    }
+
+    if (success && command == "compile") {
+        QMap<QString, QVariant> configuration = m_configuration;
+        QVariantMap requestConfig = request.value("config").toObject().toVariantMap();
+        for (auto it = requestConfig.constBegin(); it != requestConfig.constEnd(); ++it) {
+            configuration[it.key()] = it.value();
+        }
+        QJsonValue id = request.value("id");
+        success = m_compiler.build(program, configuration, [&](QString text, bool error) {
+            if (output) {
+                QJsonObject message;
+                if (!id.isUndefined()) {
+                    message["id"] = id;
+                }
+                message["type"] = QString(error ? "error" : "output");
+                message["text"] = text;
+                send(output, message);
+            }
+        });
+        result["productsDir"] = program.productsFile + "_Products";
+    }
+    result["success"] = success;
+    result["elapsedMs"] = timer.elapsed();
+    if (output) {
+        send(output, result);
+    }
+}
+
+void CompileServer::send(QLocalSocket *socket, QJsonObject message)
+{
+    socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + "\n");
+    socket->flush();
+}
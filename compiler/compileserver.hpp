@@ -0,0 +1,90 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef COMPILESERVER_HPP
+#define COMPILESERVER_HPP
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QList>
+#include <QPair>
+#include <QPointer>
+#include <QVariant>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include "stridecompiler.hpp"
+
+/// "stridecc --server": accepts compile requests on a local socket and keeps
+/// systems and their libraries loaded between requests.
+///
+/// Requests and replies are JSON objects, one per line. A request is
+///   {"id": ..., "command": "compile" | "check" | "reload" | "shutdown",
+///    "file": "path.stride", "source": "...", "config": {...}}
+/// "source" is optional and replaces the contents of "file". "check" only
+/// parses and validates. "reload" drops the loaded systems.
+/// For each request the server sends any number of
+///   {"id": ..., "type": "diagnostic", "file": ..., "line": ..., "code": ..., "message": ...}
+///   {"id": ..., "type": "output" | "error", "text": ...}
+/// followed by
+///   {"id": ..., "type": "result", "success": true|false, "productsDir": ..., "elapsedMs": ...}
+class CompileServer : public QObject
+{
+    Q_OBJECT
+public:
+    CompileServer(QString strideRoot, QMap<QString, QVariant> configuration = QMap<QString, QVariant>(),
+                  QObject *parent = nullptr);
+
+    bool listen(QString name);
+    QString errorString() const { return m_server.errorString(); }
+
+private slots:
+    void newConnection();
+    void readRequests();
+    void processQueue();
+
+private:
+    void handleRequest(QLocalSocket *socket, QJsonObject request);
+    void send(QLocalSocket *socket, QJsonObject message);
+
+    QLocalServer m_server;
+    StrideCompiler m_compiler;
+    QMap<QString, QVariant> m_configuration;
+    QList<QPair<QPointer<QLocalSocket>, QJsonObject>> m_queue;
+    bool m_busy;
+};
+
+#endif // COMPILESERVER_HPP
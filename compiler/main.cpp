@@ -39,9 +39,11 @@
 #include <QFileInfo>
 #include <QDir>
 
-//#include "ast.h"
-#include "codevalidator.h"
-#include "pythonproject.h"
+#include "stridecompiler.hpp"
+#include "batchcompiler.hpp"
+#include "benchmarkrunner.hpp"
+#include "compileserver.hpp"
+#include "symbolmanifest.hpp"
 
 int main(int argc, char *argv[])
 {
@@ -53,80 +55,156 @@ int main(int argc, char *argv[])
     parser.setApplicationDescription("Stride command line compiler");
     parser.addHelpOption();
     parser.addVersionOption();
-    parser.addPositionalArgument("source", QCoreApplication::translate("main", "Source file to build."));
+    parser.addPositionalArgument("source", QCoreApplication::translate("main", "Source files to build."), "[source...]");
 //    parser.addPositionalArgument("destination", QCoreApplication::translate("main", "Destination directory."));
 
     QCommandLineOption targetDirectoryOption(QStringList() << "s" << "stride-root",
                                              QCoreApplication::translate("main", "Path to strideroot directory"),
                                              QCoreApplication::translate("main", "directory"));
     parser.addOption(targetDirectoryOption);
+    QCommandLineOption configOption(QStringList() << "c" << "config",
+                                    QCoreApplication::translate("main", "Set framework configuration value (e.g. BlockSize=256). Can be given more than once."),
+                                    QCoreApplication::translate("main", "key=value"));
+    parser.addOption(configOption);
+    QCommandLineOption benchmarkOption(QStringList() << "b" << "benchmark",
+                                       QCoreApplication::translate("main", "Build sources against the testing domain and report their throughput. Sources can be directories."));
+    parser.addOption(benchmarkOption);
+    QCommandLineOption baselineOption("baseline",
+                                      QCoreApplication::translate("main", "Compare benchmark results to baseline file."),
+                                      QCoreApplication::translate("main", "file"));
+    parser.addOption(baselineOption);
+    QCommandLineOption resultsOption("results",
+                                     QCoreApplication::translate("main", "Write benchmark results to file."),
+                                     QCoreApplication::translate("main", "file"));
+    parser.addOption(resultsOption);
+    QCommandLineOption toleranceOption("tolerance",
+                                       QCoreApplication::translate("main", "Allowed slowdown against baseline in percent (default 10)."),
+                                       QCoreApplication::translate("main", "percent"), "10");
+    parser.addOption(toleranceOption);
+    QCommandLineOption serverOption("server",
+                                    QCoreApplication::translate("main", "Run as a compile server listening on a local socket (default name \"stridecc\")."));
+    parser.addOption(serverOption);
+    QCommandLineOption serverNameOption("server-name",
+                                        QCoreApplication::translate("main", "Local socket name for the compile server."),
+                                        QCoreApplication::translate("main", "name"), "stridecc");
+    parser.addOption(serverNameOption);
+    QCommandLineOption manifestOption(QStringList() << "m" << "manifest",
+                                      QCoreApplication::translate("main", "Build the sources listed in file, one per line."),
+                                      QCoreApplication::translate("main", "file"));
+    parser.addOption(manifestOption);
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+                                  QCoreApplication::translate("main", "Number of programs to build at once when building several (default: number of cores)."),
+                                  QCoreApplication::translate("main", "count"), "0");
+    parser.addOption(jobsOption);
+    QCommandLineOption reportOption("report",
+                                    QCoreApplication::translate("main", "Write per-program build results to JSON file."),
+                                    QCoreApplication::translate("main", "file"));
+    parser.addOption(reportOption);
     parser.process(app);
 
     const QStringList args = parser.positionalArguments();
     QString platformRootPath = parser.value(targetDirectoryOption);
 
-    if (args.size() < 1) {
-        parser.helpText();
-        return -1;
-    }
-    QString fileName = args.at(0);
-
     if (platformRootPath.isEmpty()) {
         platformRootPath = "/home/andres/Documents/src/Stride/Stride/strideroot"; // For my convenience :)
     }
 
-//    qDebug() << args.at(0);
-//    qDebug() << platformRootPath;
-
-    ASTNode tree;
-    tree = AST::parseFile(fileName.toLocal8Bit().constData());
+    QMap<QString, QVariant> configuration;
+    for (QString setting: parser.values(configOption)) {
+        int separator = setting.indexOf('=');
+        if (separator < 1) {
+            qDebug() << "Invalid configuration value:" << setting;
+            return -1;
+        }
+        QString value = setting.mid(separator + 1);
+        bool isNumber = false;
+        double number = value.toDouble(&isNumber);
+        if (isNumber) {
+            configuration[setting.left(separator)] = number;
+        } else if (value == "true" || value == "false") {
+            configuration[setting.left(separator)] = (value == "true");
+        } else {
+            configuration[setting.left(separator)] = value;
+        }
+    }
 
-    bool buildOK = true;
-    if (tree) {
-        CodeValidator validator(platformRootPath, tree);
+    if (configuration.contains("BuildCacheDir")) {
+        // The generator runs in the stride root, so pass it an absolute path
+        QString cacheDir = QDir(configuration["BuildCacheDir"].toString()).absolutePath();
+        configuration["BuildCacheDir"] = cacheDir;
+        SymbolManifest::setCacheDirectory(cacheDir);
+    }
 
-        if (!validator.isValid()) {
-            QList<LangError> errors = validator.getErrors();
-            for (LangError error: errors) {
-                qDebug() << QString::fromStdString(error.getErrorText());
-            }
+    if (parser.isSet(serverOption)) {
+        CompileServer server(platformRootPath, configuration);
+        if (!server.listen(parser.value(serverNameOption))) {
+            qDebug() << "Can't start compile server:" << server.errorString();
             return -1;
         }
-        std::shared_ptr<StrideSystem> platform = validator.getSystem();
-
-        QFileInfo info(fileName);
-        QString dirName = info.absolutePath() + QDir::separator()
-                + info.fileName();
-        if (!QFile::exists(dirName)) {
-            if (!QDir().mkpath(dirName)) {
-                qDebug() << "Error creating project path";
-                return -1;
+        qDebug() << "Compile server listening on" << parser.value(serverNameOption);
+        return app.exec();
+    }
+
+    if (args.size() < 1 && !parser.isSet(manifestOption)) {
+        parser.helpText();
+        return -1;
+    }
+
+    if (parser.isSet(benchmarkOption)) {
+        BenchmarkRunner runner(platformRootPath, configuration);
+        int failed = 0;
+        for (QString source: BenchmarkRunner::findSources(args)) {
+            if (!runner.benchmark(source)) {
+                failed++;
             }
         }
-        std::vector<std::string> domains = CodeValidator::getUsedDomains(tree);
-        std::vector<std::string> usedFrameworks;
-        for (string domain: domains) {
-            usedFrameworks.push_back(CodeValidator::getFrameworkForDomain(domain, tree));
+        if (parser.isSet(resultsOption)) {
+            runner.writeResults(parser.value(resultsOption));
         }
-        vector<Builder *> builders = platform->createBuilders(dirName, usedFrameworks);
-        for (auto builder: builders) {
-            if (builder->build(tree)) {
-                qDebug() << "Built in directory:" << dirName;
-            } else {
-                qDebug() << "Build failed for " << fileName;
-                qDebug() << "Using framework: " << builder->getPlatformPath();
-
-                qDebug() << builder->getStdOut();
-                qDebug() << builder->getStdErr();
-                buildOK = false;
-            }
+        int regressions = 0;
+        if (parser.isSet(baselineOption)) {
+            regressions = runner.compareToBaseline(parser.value(baselineOption),
+                                                   parser.value(toleranceOption).toDouble());
+        }
+        if (failed > 0) {
+            qDebug() << failed << "benchmarks failed to build or run";
+        }
+        return (failed == 0 && regressions == 0) ? 0 : -1;
+    }
+
+    if (args.size() > 1 || parser.isSet(manifestOption) || QFileInfo(args.at(0)).isDir()) {
+        BatchCompiler batch(platformRootPath, configuration, parser.value(jobsOption).toInt());
+        if (parser.isSet(manifestOption) && !batch.addManifest(parser.value(manifestOption))) {
+            qDebug() << "Can't read manifest:" << parser.value(manifestOption);
+            return -1;
         }
-    } else {
-        vector<LangError> errors = AST::getParseErrors();
-        for (LangError err: errors) {
-           qDebug() << QString::fromStdString(err.getErrorText());
+        for (QString source: BenchmarkRunner::findSources(args)) {
+            batch.addSource(source);
         }
-        buildOK = false;
+        bool batchOK = batch.run();
+        if (parser.isSet(reportOption) && !batch.writeReport(parser.value(reportOption))) {
+            qDebug() << "Can't write report:" << parser.value(reportOption);
+        }
+        return batchOK ? 0 : -1;
+    }
+
+    QString fileName = args.at(0);
+    StrideCompiler compiler(platformRootPath);
+    StrideCompiler::Program program;
+    program.fileName = fileName;
+    if (!compiler.prepare(program)) {
+        for (LangError error: program.errors) {
+            qDebug() << QString::fromStdString(error.getErrorText());
+        }
+        return -1;
+    }
+    QString dirName = program.productsFile;
+    if (compiler.build(program, configuration)) {
+        qDebug() << "Built in directory:" << dirName;
+        return 0;
     }
-    return buildOK ? 0: -1;
+    qDebug() << "Build failed for " << fileName;
+    qDebug() << program.stdOut;
+    qDebug() << program.stdErr;
+    return -1;
 }
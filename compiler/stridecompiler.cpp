@@ -0,0 +1,132 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+#include "stridecompiler.hpp"
+#include "codevalidator.h"
+
+StrideCompiler::StrideCompiler(QString strideRoot) :
+    m_strideRoot(strideRoot),
+    m_systems(strideRoot),
+    m_incremental(false)
+{
+}
+
+bool StrideCompiler::prepare(Program &program, QString source)
+{
+    program.errors.clear();
+    program.usedFrameworks.clear();
+    QFileInfo info(program.fileName);
+    if (source.isEmpty()) {
+        program.tree = AST::parseFile(program.fileName.toLocal8Bit().constData());
+    } else {
+        // Parse from a temporary file, but report errors against fileName
+        QTemporaryFile sourceFile(QDir::tempPath() + QDir::separator() + "stridecc_XXXXXX.stride");
+        if (!sourceFile.open()) {
+            LangError error;
+            error.type = LangError::SystemError;
+            error.errorTokens.push_back("Can't write temporary source file");
+            error.filename = program.fileName.toStdString();
+            error.lineNumber = -1;
+            program.errors.append(error);
+            return false;
+        }
+        sourceFile.write(source.toUtf8());
+        sourceFile.close();
+        program.tree = AST::parseFile(sourceFile.fileName().toLocal8Bit().constData(),
+                                      program.fileName.toLocal8Bit().constData());
+    }
+    vector<LangError> syntaxErrors = AST::getParseErrors();
+    for (LangError error: syntaxErrors) {
+        program.errors.append(error);
+    }
+    if (!program.tree || program.errors.size() > 0) {
+        return false;
+    }
+
+    program.system = m_systems.getSystem(program.tree);
+    QList<LangError> errors;
+    if (m_incremental) {
+        std::shared_ptr<IncrementalResolver> &resolver = m_resolvers[program.fileName];
+        if (!resolver || resolver->getSystem() != program.system) {
+            resolver = std::make_shared<IncrementalResolver>(program.system);
+        }
+        // The validator optimizes a copy of the resolved tree
+        CodeValidator validator(*resolver, program.tree, CodeValidator::OPTIMIZE);
+        errors = validator.getErrors();
+        program.tree = validator.getTree();
+    } else {
+        CodeValidator validator(program.system, program.tree, CodeValidator::OPTIMIZE);
+        errors = validator.getErrors();
+    }
+    if (errors.size() > 0) {
+        program.errors = errors;
+        return false;
+    }
+    for (string domain: CodeValidator::getUsedDomains(program.tree)) {
+        program.usedFrameworks.push_back(CodeValidator::getFrameworkForDomain(domain, program.tree));
+    }
+    program.productsFile = info.absolutePath() + QDir::separator() + info.fileName();
+    return true;
+}
+
+bool StrideCompiler::build(Program &program, QMap<QString, QVariant> configuration,
+                           OutputCallback output)
+{
+    if (!program.tree || !program.system) {
+        return false;
+    }
+    // Builders must be created in the building thread as they own QProcess objects
+    vector<Builder *> builders = program.system->createBuilders(program.productsFile,
+                                                                program.usedFrameworks);
+    bool buildOK = builders.size() > 0;
+    for (auto builder: builders) {
+        if (output) {
+            QObject::connect(builder, &Builder::outputText, [&](QString text) { output(text, false); });
+            QObject::connect(builder, &Builder::errorText, [&](QString text) { output(text, true); });
+        }
+        builder->setConfiguration(configuration);
+        if (!builder->build(program.tree)) {
+            buildOK = false;
+        }
+        program.stdOut += builder->getStdOut();
+        program.stdErr += builder->getStdErr();
+        delete builder;
+    }
+    return buildOK;
+}
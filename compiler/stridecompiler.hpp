@@ -0,0 +1,96 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef STRIDECOMPILER_HPP
+#define STRIDECOMPILER_HPP
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QVariant>
+
+#include "ast.h"
+#include "langerror.h"
+#include "stridesystem.hpp"
+#include "stridesystemcache.hpp"
+#include "incrementalresolver.hpp"
+
+/// Compiles Stride programs with systems that stay loaded between programs.
+/// prepare() parses and validates and must not be called concurrently (the
+/// parser is not reentrant). build() generates and compiles the products
+/// and can run in several threads at once for different programs.
+class StrideCompiler
+{
+public:
+    typedef struct {
+        QString fileName;
+        ASTNode tree;
+        std::shared_ptr<StrideSystem> system;
+        std::vector<std::string> usedFrameworks;
+        QList<LangError> errors;
+        QString productsFile; // Builders create <productsFile>_Products
+        QString stdOut;
+        QString stdErr;
+    } Program;
+
+    // Receives builder output while building. error is true for stderr text
+    typedef std::function<void(QString text, bool error)> OutputCallback;
+
+    StrideCompiler(QString strideRoot);
+
+    /// If source is not empty it is compiled instead of the contents of fileName.
+    bool prepare(Program &program, QString source = QString());
+    bool build(Program &program, QMap<QString, QVariant> configuration,
+               OutputCallback output = OutputCallback());
+
+    /// Keep resolution results for each file, so preparing a new version of a
+    /// file only resolves what changed.
+    void setIncremental(bool incremental) { m_incremental = incremental; }
+
+    void clearCache() { m_systems.clear(); m_resolvers.clear(); }
+    int cachedSystems() { return m_systems.size(); }
+
+private:
+    QString m_strideRoot;
+    StrideSystemCache m_systems;
+    bool m_incremental;
+    QMap<QString, std::shared_ptr<IncrementalResolver>> m_resolvers;
+};
+
+#endif // STRIDECOMPILER_HPP
@@ -154,7 +154,7 @@ bool ProjectWindow::build()
     if (tree) {
         SystemConfiguration systemConfig = readProjectConfiguration();
         CodeValidator validator(m_environment["platformRootPath"].toString(), tree,
-                CodeValidator::NO_OPTIONS, systemConfig);
+                CodeValidator::OPTIMIZE, systemConfig);
         errors << validator.getErrors();
 
         if (errors.size() > 0) {
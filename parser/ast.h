@@ -92,6 +92,7 @@ public:
     virtual void setChildren(vector<ASTNode> &newChildren);
 
     int getLine() const {return m_line;}
+    void setLine(int line) {m_line = line;}
 
 //    virtual void deleteChildren();
 
@@ -33,6 +33,7 @@
 */
 
 #include <cassert>
+#include <algorithm>
 
 #include "functionnode.h"
 #include "scopenode.h"
@@ -159,6 +160,19 @@ bool FunctionNode::replacePropertyValue(string propertyName, ASTNode newValue)
     return replaced;
 }
 
+bool FunctionNode::removeProperty(string propertyName)
+{
+    for (unsigned int i = 0; i < m_properties.size(); i++) {
+        if (m_properties.at(i)->getName() == propertyName) {
+            ASTNode property = m_properties.at(i);
+            m_children.erase(std::find(m_children.begin(), m_children.end(), property));
+            m_properties.erase(m_properties.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
 void FunctionNode::resolveScope(ASTNode scope)
 {
     if (scope) {
@@ -59,6 +59,7 @@ public:
     ASTNode getPropertyValue(string propertyName);
     void setPropertyValue(string propertyName, ASTNode value);
     bool replacePropertyValue(string propertyName, ASTNode newValue);
+    bool removeProperty(string propertyName);
 
     ASTNode getDomain();
     void setDomainString(string domain);
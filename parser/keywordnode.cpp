@@ -40,6 +40,10 @@ KeywordNode::KeywordNode(string keyword, const char *filename, int line)
     m_kw = keyword;
 }
 
-//AST *KeywordNode::deepCopy() {
-//    return new KeywordNode(keyword(), m_filename.data(), getLine());
-//}
+ASTNode KeywordNode::deepCopy() {
+    ASTNode newNode = std::make_shared<KeywordNode>(m_kw, m_filename.data(), getLine());
+    for (unsigned int i = 0; i < this->getScopeLevels(); i++) {
+        newNode->addScope(this->getScopeAt(i));
+    }
+    return newNode;
+}
@@ -63,16 +63,18 @@ int SystemNode::minorVersion() const
     return m_minorVersion;
 }
 
-//AST *SystemNode::deepCopy()
-//{
-//    SystemNode *newnode = new SystemNode(m_systemName, m_majorVersion, m_minorVersion,
-//                                    m_filename.data() , m_line, m_targetPlatforms);
-//    vector<AST *> children = getChildren();
-//    for (unsigned int i = 0; i < children.size(); i++) {
-//        newnode->addChild(children.at(i)->deepCopy());
-//    }
-//    return newnode;
-//}
+ASTNode SystemNode::deepCopy()
+{
+    std::shared_ptr<SystemNode> newNode = std::make_shared<SystemNode>(m_systemName, m_majorVersion, m_minorVersion,
+                                                                       m_filename.data(), m_line, m_targetPlatforms);
+    for (unsigned int i = 0; i < m_children.size(); i++) {
+        newNode->addChild(m_children.at(i)->deepCopy());
+    }
+    for (unsigned int i = 0; i < this->getScopeLevels(); i++) {
+        newNode->addScope(this->getScopeAt(i));
+    }
+    return newNode;
+}
 
 vector<string> SystemNode::hwPlatforms() const
 {
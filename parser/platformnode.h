@@ -59,7 +59,7 @@ public:
     vector<string> hwPlatforms() const;
     void setHwPlatforms(const vector<string> &hwPlatforms);
 
-//    AST *deepCopy();
+    virtual ASTNode deepCopy() override;
 
 private:
     int m_minorVersion;
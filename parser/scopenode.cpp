@@ -44,3 +44,15 @@ ScopeNode::~ScopeNode()
 {
 
 }
+
+ASTNode ScopeNode::deepCopy()
+{
+    ASTNode newNode = std::make_shared<ScopeNode>(m_name, m_filename.data(), m_line);
+    for (unsigned int i = 0; i < m_children.size(); i++) {
+        newNode->addChild(m_children.at(i)->deepCopy());
+    }
+    for (unsigned int i = 0; i < this->getScopeLevels(); i++) {
+        newNode->addScope(this->getScopeAt(i));
+    }
+    return newNode;
+}
@@ -47,6 +47,8 @@ public:
 
     string getName() const {return m_name;}
 
+    virtual ASTNode deepCopy() override;
+
 private:
     string m_name;
 };
@@ -0,0 +1,228 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Worker pool that runs the independent stream clusters of a domain in
+// parallel (see BaseCTemplate.parallel_code()). Each block the calling thread
+// publishes a job and takes clusters alongside the workers, then waits until
+// all are done. Workers spin on an atomic generation counter for a while after
+// each job, so back to back blocks make no system calls, and then sleep on a
+// condition variable until the next job. Workers are pinned to cores on Linux.
+//
+// The pool is shared by all the program instances in a process. If it is
+// busy, the clusters are run serially on the calling thread.
+//
+// With STRIDE_REALTIME, workers get the same flush-to-zero and stack setup
+// as the audio thread (stride_realtime.hpp), and the core given to the audio
+// thread by STRIDE_REALTIME_CPU is left to it. As workers spin before they
+// sleep, they only run with SCHED_FIFO if STRIDE_REALTIME_WORKER_PRIORITY is
+// set above 0.
+
+#ifndef STRIDE_PARALLEL_HPP
+#define STRIDE_PARALLEL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <type_traits>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STRIDE_PARALLEL_PAUSE() _mm_pause()
+#else
+#define STRIDE_PARALLEL_PAUSE()
+#endif
+
+#ifdef STRIDE_REALTIME
+#include "stride_realtime.hpp"
+#endif
+
+#ifndef STRIDE_PARALLEL_THREADS
+#define STRIDE_PARALLEL_THREADS 1 // Worker threads besides the caller
+#endif
+
+#ifndef STRIDE_PARALLEL_SPIN
+#define STRIDE_PARALLEL_SPIN 4096 // Busy waits before an idle worker sleeps
+#endif
+
+class StrideParallelPool {
+public:
+    typedef void (*Job)(void *context, int index);
+
+    StrideParallelPool(int numWorkers) {
+        unsigned int cores = std::thread::hardware_concurrency();
+#if defined(STRIDE_REALTIME) && STRIDE_REALTIME_CPU >= 0
+        unsigned int callerCore = STRIDE_REALTIME_CPU;
+#else
+        unsigned int callerCore = 0;
+#endif
+        for (int i = 0; i < numWorkers; i++) {
+            m_workers.emplace_back(&StrideParallelPool::work, this);
+#ifdef __linux__
+            if (cores > 1) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET((callerCore + i + 1) % cores, &cpus); // Leave the caller's core to it
+                pthread_setaffinity_np(m_workers.back().native_handle(), sizeof(cpu_set_t), &cpus);
+            }
+#else
+            (void) cores;
+            (void) callerCore;
+#endif
+        }
+    }
+
+    ~StrideParallelPool() {
+        m_quit = true;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake.notify_all();
+        }
+        for (auto &worker: m_workers) {
+            worker.join();
+        }
+    }
+
+    // Calls job(context, index) for every index in [0, count) and returns
+    // when all calls have finished.
+    void run(Job job, void *context, int count) {
+        if (count <= 1 || m_workers.empty() || m_busy.exchange(true)) {
+            for (int i = 0; i < count; i++) {
+                job(context, i);
+            }
+            return;
+        }
+        m_job = job;
+        m_context = context;
+        m_count = count;
+        m_next = 0;
+        m_done = 0;
+        m_generation++; // Odd: the job is open
+        if (m_sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake.notify_all();
+        }
+        take(job, context, count);
+        while (m_done.load() < count) {
+            STRIDE_PARALLEL_PAUSE();
+        }
+        m_generation++; // Even: closed. Late workers must not read the job
+        while (m_active.load() != 0) {
+            STRIDE_PARALLEL_PAUSE();
+        }
+        m_busy = false;
+    }
+
+private:
+    void take(Job job, void *context, int count) {
+        int index;
+        while ((index = m_next.fetch_add(1)) < count) {
+            job(context, index);
+            m_done.fetch_add(1);
+        }
+    }
+
+    void work() {
+#ifdef STRIDE_REALTIME
+        stride_realtime_thread_setup(false, STRIDE_REALTIME_WORKER_PRIORITY); // Pinned by the constructor
+#endif
+        unsigned int seen = 0;
+        int spins = 0;
+        while (!m_quit.load(std::memory_order_relaxed)) {
+            unsigned int generation = m_generation.load();
+            if (generation == seen || (generation & 1) == 0) {
+                if (++spins < STRIDE_PARALLEL_SPIN) {
+                    STRIDE_PARALLEL_PAUSE();
+                    continue;
+                }
+                // run() checks m_sleeping after opening a job, so either it
+                // wakes this worker or the wait below sees the new job
+                m_sleeping++;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [this, seen]() {
+                        unsigned int next = m_generation.load();
+                        return m_quit.load() || (next != seen && (next & 1) == 1);
+                    });
+                }
+                m_sleeping--;
+                spins = 0;
+                continue;
+            }
+            seen = generation;
+            spins = 0;
+            m_active++;
+            if (m_generation.load() == generation) {
+                take(m_job, m_context, m_count);
+            }
+            m_active--;
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::atomic<unsigned int> m_generation {0};
+    std::atomic<int> m_next {0};
+    std::atomic<int> m_done {0};
+    std::atomic<int> m_active {0};
+    std::atomic<bool> m_busy {false};
+    std::atomic<bool> m_quit {false};
+    std::atomic<int> m_sleeping {0};
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    Job m_job {nullptr};
+    void *m_context {nullptr};
+    int m_count {0};
+};
+
+inline StrideParallelPool &stride_parallel_pool() {
+    static StrideParallelPool pool(STRIDE_PARALLEL_THREADS);
+    return pool;
+}
+
+// Runs f(index) for every index in [0, count) on the pool
+template<typename F>
+inline void stride_parallel_run(int count, F &&f) {
+    typedef typename std::remove_reference<F>::type Function;
+    stride_parallel_pool().run([](void *context, int index) {
+        (*static_cast<Function *>(context))(index);
+    }, (void *) &f, count);
+}
+
+#endif // STRIDE_PARALLEL_HPP
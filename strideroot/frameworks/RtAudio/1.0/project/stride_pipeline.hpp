@@ -0,0 +1,135 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Block rings for pipelined execution of a domain (see
+// BaseCTemplate.pipeline_code()). The domain's streams are split into
+// STRIDE_PIPELINE_STAGES stages. Stage s processes the block that stage 0
+// processed s blocks earlier, so all stages can run at the same time on
+// the worker pool. The input of each block is kept until the last stage has
+// used it, and its output is queued and returned STRIDE_PIPELINE_STAGES - 1
+// blocks late. Signals passed between stages are kept in rings of the same
+// depth, indexed with slot(), so a stage never reads a slot being written.
+//
+// Callbacks larger than STRIDE_PIPELINE_FRAMES are processed in blocks of
+// at most that size.
+
+#ifndef STRIDE_PIPELINE_HPP
+#define STRIDE_PIPELINE_HPP
+
+#include <cstring>
+
+#ifndef STRIDE_PIPELINE_FRAMES
+#define STRIDE_PIPELINE_FRAMES 512 // Largest block processed by a stage
+#endif
+
+template<typename Sample, int InChannels, int OutChannels, int Stages>
+class StridePipeline {
+public:
+    StridePipeline() {
+        memset(m_input, 0, sizeof(m_input));
+        memset(m_output, 0, sizeof(m_output));
+        memset(m_frames, 0, sizeof(m_frames));
+        memset(m_queue, 0, sizeof(m_queue));
+    }
+
+    int chunks(int frames) const {
+        return (frames + STRIDE_PIPELINE_FRAMES - 1) / STRIDE_PIPELINE_FRAMES;
+    }
+
+    // Stores the input of a new block for the first stage
+    void begin(const Sample *in, int frames, int chunk) {
+        int offset = chunk * STRIDE_PIPELINE_FRAMES;
+        int size = frames - offset < STRIDE_PIPELINE_FRAMES ? frames - offset : STRIDE_PIPELINE_FRAMES;
+        int slot = (int) (m_block % Stages);
+        memcpy(m_input[slot], in + offset * InChannels, size * InChannels * sizeof(Sample));
+        m_frames[slot] = size;
+    }
+
+    // Queues the oldest block, which all stages have now processed, and
+    // writes as many frames as the chunk holds. Silence until it fills.
+    void end(Sample *out, int frames, int chunk) {
+        int offset = chunk * STRIDE_PIPELINE_FRAMES;
+        int size = frames - offset < STRIDE_PIPELINE_FRAMES ? frames - offset : STRIDE_PIPELINE_FRAMES;
+        if (m_block >= (unsigned long long) (Stages - 1)) {
+            int slot = (int) ((m_block - (Stages - 1)) % Stages);
+            for (int i = 0; i < m_frames[slot]; i++) {
+                memcpy(m_queue[m_queueEnd], m_output[slot] + i * OutChannels, OutChannels * sizeof(Sample));
+                m_queueEnd = (m_queueEnd + 1) % QueueFrames;
+            }
+            m_queued += m_frames[slot];
+            memset(m_output[slot], 0, sizeof(m_output[slot]));
+        }
+        out += offset * OutChannels;
+        int ready = m_queued < size ? m_queued : size;
+        memset(out, 0, (size - ready) * OutChannels * sizeof(Sample));
+        out += (size - ready) * OutChannels;
+        for (int i = 0; i < ready; i++) {
+            memcpy(out + i * OutChannels, m_queue[m_queueStart], OutChannels * sizeof(Sample));
+            m_queueStart = (m_queueStart + 1) % QueueFrames;
+        }
+        m_queued -= ready;
+        m_block++;
+    }
+
+    // Number of frames for a stage in this block. 0 while the pipeline fills.
+    int frames(int stage) const {
+        return m_block >= (unsigned long long) stage ? m_frames[slot(stage)] : 0;
+    }
+
+    int slot(int stage) const {
+        return (int) ((m_block + Stages - stage) % Stages);
+    }
+
+    const Sample *input(int stage) const {
+        return m_input[slot(stage)];
+    }
+
+    Sample *output(int stage) {
+        return m_output[slot(stage)];
+    }
+
+private:
+    static const int QueueFrames = (Stages + 1) * STRIDE_PIPELINE_FRAMES;
+
+    Sample m_input[Stages][STRIDE_PIPELINE_FRAMES * InChannels];
+    Sample m_output[Stages][STRIDE_PIPELINE_FRAMES * OutChannels];
+    int m_frames[Stages];
+    unsigned long long m_block {0};
+    Sample m_queue[QueueFrames][OutChannels];
+    int m_queueStart {0};
+    int m_queueEnd {0};
+    int m_queued {0};
+};
+
+#endif // STRIDE_PIPELINE_HPP
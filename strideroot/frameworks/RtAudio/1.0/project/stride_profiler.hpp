@@ -0,0 +1,227 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Profiling runtime for generated code. Included when the "Profile"
+// configuration option is set. Every stream and module process function is
+// wrapped in a StrideProfileScope that adds its elapsed time to per-thread
+// counters. Counters are only written by their own thread, so no locks or
+// atomic read-modify-write operations are needed on the processing thread.
+// The profile is printed on exit, or when the process receives SIGUSR1.
+
+#ifndef STRIDE_PROFILER_HPP
+#define STRIDE_PROFILER_HPP
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <csignal>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define STRIDE_PROFILE_UNITS "cycles"
+inline uint64_t stride_profile_now() { return __rdtsc(); }
+#else
+#include <time.h>
+#define STRIDE_PROFILE_UNITS "ns"
+inline uint64_t stride_profile_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+#endif
+
+#ifndef STRIDE_PROFILE_MAX_SITES
+#define STRIDE_PROFILE_MAX_SITES 4096
+#endif
+
+#ifndef STRIDE_PROFILE_MAX_THREADS
+#define STRIDE_PROFILE_MAX_THREADS 16
+#endif
+
+typedef struct {
+    const char *file;
+    int line;
+    const char *label;
+} StrideProfileSite;
+
+struct StrideProfileThreadData {
+    std::atomic<uint64_t> time[STRIDE_PROFILE_MAX_SITES];
+    std::atomic<uint64_t> calls[STRIDE_PROFILE_MAX_SITES];
+    StrideProfileThreadData *next;
+};
+
+struct StrideProfiler {
+    std::atomic<StrideProfileThreadData *> threads {nullptr};
+    const StrideProfileSite *sites {nullptr};
+    int numSites {0};
+    std::atomic<bool> dumpRequested {false};
+    StrideProfileThreadData *slots[STRIDE_PROFILE_MAX_THREADS] {};
+    std::atomic<int> nextSlot {0};
+
+    static StrideProfiler &instance() {
+        static StrideProfiler profiler;
+        return profiler;
+    }
+
+    // Allocates the counters for all threads up front, so that no memory is
+    // allocated on the processing threads, and pushes them onto a list that
+    // the dump can walk.
+    void allocateThreads() {
+        for (int t = 0; t < STRIDE_PROFILE_MAX_THREADS; t++) {
+            StrideProfileThreadData *data = new StrideProfileThreadData;
+            for (int i = 0; i < STRIDE_PROFILE_MAX_SITES; i++) {
+                data->time[i].store(0, std::memory_order_relaxed);
+                data->calls[i].store(0, std::memory_order_relaxed);
+            }
+            data->next = threads.load(std::memory_order_relaxed);
+            threads.store(data, std::memory_order_release);
+            slots[t] = data;
+        }
+    }
+
+    // Claims a slot the first time a thread is profiled. Threads beyond
+    // STRIDE_PROFILE_MAX_THREADS are not profiled.
+    StrideProfileThreadData *threadData() {
+        static thread_local StrideProfileThreadData *data = nullptr;
+        static thread_local bool claimed = false;
+        if (!claimed) {
+            int slot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+            data = slot < STRIDE_PROFILE_MAX_THREADS ? slots[slot] : nullptr;
+            claimed = true;
+        }
+        return data;
+    }
+
+    void dump(FILE *out) {
+        // Aggregate all threads by source line, keeping the labels of the sites on that line
+        std::map<std::pair<std::string, int>, std::pair<uint64_t, uint64_t>> lines;
+        std::map<std::pair<std::string, int>, std::string> labels;
+        uint64_t total = 0;
+        for (StrideProfileThreadData *data = threads.load(std::memory_order_acquire); data; data = data->next) {
+            for (int i = 0; i < numSites && i < STRIDE_PROFILE_MAX_SITES; i++) {
+                uint64_t calls = data->calls[i].load(std::memory_order_relaxed);
+                if (calls == 0) {
+                    continue;
+                }
+                std::pair<std::string, int> key(sites[i].file, sites[i].line);
+                uint64_t time = data->time[i].load(std::memory_order_relaxed);
+                lines[key].first += time;
+                lines[key].second += calls;
+                std::string &label = labels[key];
+                if (label.find(sites[i].label) == std::string::npos) {
+                    label += label.empty() ? sites[i].label : std::string(", ") + sites[i].label;
+                }
+                if (sites[i].line < 0) {
+                    total += time; // Domain totals
+                }
+            }
+        }
+        std::vector<std::pair<std::pair<std::string, int>, std::pair<uint64_t, uint64_t>>> sorted(lines.begin(), lines.end());
+        std::sort(sorted.begin(), sorted.end(), [](const decltype(sorted)::value_type &a, const decltype(sorted)::value_type &b) {
+            return a.second.first > b.second.first;
+        });
+        fprintf(out, "\n---- Stride profile (" STRIDE_PROFILE_UNITS ", inclusive) ----\n");
+        fprintf(out, "%-40s %14s %12s %12s %7s  %s\n", "location", "total", "calls", "per call", "%", "what");
+        for (auto &entry: sorted) {
+            char location[512];
+            if (entry.first.second >= 0) {
+                snprintf(location, sizeof(location), "%s:%i", entry.first.first.c_str(), entry.first.second);
+            } else {
+                snprintf(location, sizeof(location), "%s", entry.first.first.c_str());
+            }
+            double percent = total > 0 ? 100.0 * entry.second.first / total : 0.0;
+            fprintf(out, "%-40s %14llu %12llu %12.1f %6.1f%%  %s\n", location,
+                    (unsigned long long) entry.second.first, (unsigned long long) entry.second.second,
+                    (double) entry.second.first / entry.second.second, percent,
+                    labels[entry.first].c_str());
+        }
+        fflush(out);
+    }
+};
+
+class StrideProfileScope {
+public:
+    explicit StrideProfileScope(int site) : m_site(site), m_start(stride_profile_now()) {}
+    ~StrideProfileScope() {
+        uint64_t elapsed = stride_profile_now() - m_start;
+        StrideProfileThreadData *data = StrideProfiler::instance().threadData();
+        if (!data) {
+            return;
+        }
+        data->time[m_site].store(data->time[m_site].load(std::memory_order_relaxed) + elapsed, std::memory_order_relaxed);
+        data->calls[m_site].store(data->calls[m_site].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+private:
+    int m_site;
+    uint64_t m_start;
+};
+
+inline void stride_profile_dump_at_exit() {
+    StrideProfiler::instance().dump(stderr);
+}
+
+inline void stride_profile_signal_handler(int) {
+    StrideProfiler::instance().dumpRequested.store(true);
+}
+
+// Called from the generated initialization code
+inline void stride_profile_init(const StrideProfileSite *sites, int numSites) {
+    StrideProfiler &profiler = StrideProfiler::instance();
+    profiler.sites = sites;
+    profiler.numSites = numSites;
+    profiler.allocateThreads();
+    std::atexit(stride_profile_dump_at_exit);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, stride_profile_signal_handler);
+    std::thread([]() {
+        StrideProfiler &profiler = StrideProfiler::instance();
+        while (true) {
+            if (profiler.dumpRequested.exchange(false)) {
+                profiler.dump(stderr);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }).detach();
+#endif
+}
+
+#endif // STRIDE_PROFILER_HPP
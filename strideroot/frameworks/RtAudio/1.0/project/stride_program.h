@@ -0,0 +1,64 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// C interface to a Stride program built with the "Library" option. All the
+// state of the program lives in one StrideProgram object, so any number of
+// independent instances can be created and run side by side. An instance
+// must only be processed by one thread at a time.
+// Audio buffers are interleaved, with stride_num_inputs() and
+// stride_num_outputs() channels per frame.
+
+#ifndef STRIDE_PROGRAM_H
+#define STRIDE_PROGRAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct StrideProgram StrideProgram;
+
+StrideProgram *stride_create(void);
+void stride_process_block(StrideProgram *program, const float *in, float *out, unsigned int frames);
+void stride_reset(StrideProgram *program);
+void stride_destroy(StrideProgram *program);
+
+int stride_num_inputs(void);
+int stride_num_outputs(void);
+int stride_sample_rate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STRIDE_PROGRAM_H
@@ -0,0 +1,256 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Real-time setup for the generated program, enabled with STRIDE_REALTIME.
+//
+//  * stride_realtime_setup(), before the audio stream is opened: locks all
+//    current and future memory, stops malloc from returning memory to the
+//    system and pre-faults STRIDE_REALTIME_HEAP_MB of heap.
+//  * STRIDE_REALTIME_CALLBACK() at the start of the audio callback: the
+//    first time on each thread, sets SCHED_FIFO with STRIDE_REALTIME_PRIORITY,
+//    pins the thread to STRIDE_REALTIME_CPU if not negative, enables
+//    flush-to-zero and denormals-are-zero and pre-faults the stack.
+//    stride_parallel.hpp does the same at the start of each worker thread,
+//    which it pins to its own core, but workers only get SCHED_FIFO if
+//    STRIDE_REALTIME_WORKER_PRIORITY is above 0, as they spin while idle.
+//
+// With STRIDE_REALTIME_DEBUG, malloc, free and pthread_mutex_lock are
+// interposed (Linux and glibc only) and any call made inside the callback is
+// reported on stderr and raises SIGTRAP, so a debugger stops at the caller.
+//
+// Without STRIDE_REALTIME both are no-ops.
+
+#ifndef STRIDE_REALTIME_HPP
+#define STRIDE_REALTIME_HPP
+
+#ifdef STRIDE_REALTIME
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <malloc.h>
+#endif
+
+#ifndef STRIDE_REALTIME_PRIORITY
+#define STRIDE_REALTIME_PRIORITY 80
+#endif
+
+#ifndef STRIDE_REALTIME_WORKER_PRIORITY
+#define STRIDE_REALTIME_WORKER_PRIORITY 0 // Workers keep the default scheduling
+#endif
+
+#ifndef STRIDE_REALTIME_CPU
+#define STRIDE_REALTIME_CPU -1
+#endif
+
+#ifndef STRIDE_REALTIME_HEAP_MB
+#define STRIDE_REALTIME_HEAP_MB 16
+#endif
+
+#ifndef STRIDE_REALTIME_STACK_KB
+#define STRIDE_REALTIME_STACK_KB 256
+#endif
+
+// Only write() is used for messages, as it neither allocates nor locks
+inline void stride_realtime_message(const char *text) {
+#ifdef __linux__
+    ssize_t written = write(2, text, strlen(text));
+    (void) written;
+#else
+    (void) text;
+#endif
+}
+
+inline void stride_realtime_setup() {
+#ifdef __linux__
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        stride_realtime_message("STRIDE_REALTIME: mlockall failed. Memory may be paged out.\n");
+    }
+#ifdef __GLIBC__
+    mallopt(M_TRIM_THRESHOLD, -1); // Keep freed memory
+    mallopt(M_MMAP_MAX, 0); // Serve all allocations from the locked heap
+#endif
+    const size_t heapSize = (size_t) STRIDE_REALTIME_HEAP_MB * 1024 * 1024;
+    char *heap = (char *) malloc(heapSize);
+    if (heap) {
+        long pageSize = sysconf(_SC_PAGESIZE);
+        for (size_t i = 0; i < heapSize; i += pageSize) {
+            ((volatile char *) heap)[i] = 0;
+        }
+        free(heap);
+    }
+#endif
+}
+
+#ifdef STRIDE_REALTIME_DEBUG
+inline bool &stride_realtime_in_callback() {
+    static thread_local bool inCallback = false;
+    return inCallback;
+}
+#endif
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+inline void stride_realtime_prefault_stack() {
+    volatile char stack[STRIDE_REALTIME_STACK_KB * 1024];
+    for (size_t i = 0; i < sizeof(stack); i += 1024) {
+        stack[i] = 0;
+    }
+}
+
+// pin is false for threads that are pinned elsewhere. SCHED_FIFO is only
+// set if priority is above 0
+inline void stride_realtime_thread_setup(bool pin = true, int priority = STRIDE_REALTIME_PRIORITY) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_setcsr(_mm_getcsr() | 0x8040); // FTZ and DAZ
+#elif defined(__aarch64__)
+    unsigned long long fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    __asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ULL << 24))); // FZ
+#endif
+#ifdef __linux__
+    if (priority > 0) {
+        sched_param param;
+        param.sched_priority = priority;
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+            stride_realtime_message("STRIDE_REALTIME: Could not set SCHED_FIFO. Check rtprio limits.\n");
+        }
+    }
+    if (pin && STRIDE_REALTIME_CPU >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(STRIDE_REALTIME_CPU, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus) != 0) {
+            stride_realtime_message("STRIDE_REALTIME: Could not set the audio thread's CPU.\n");
+        }
+    }
+#endif
+    stride_realtime_prefault_stack();
+}
+
+class StrideRealtimeScope {
+public:
+    StrideRealtimeScope() {
+        static thread_local bool threadReady = false;
+        if (!threadReady) {
+            stride_realtime_thread_setup();
+            threadReady = true;
+        }
+#ifdef STRIDE_REALTIME_DEBUG
+        stride_realtime_in_callback() = true;
+#endif
+    }
+#ifdef STRIDE_REALTIME_DEBUG
+    ~StrideRealtimeScope() {
+        stride_realtime_in_callback() = false;
+    }
+#endif
+};
+
+#if defined(STRIDE_REALTIME_DEBUG) && defined(__linux__) && defined(__GLIBC__)
+#include <dlfcn.h>
+#include <signal.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+}
+
+inline void stride_realtime_violation(const char *function) {
+    if (stride_realtime_in_callback()) {
+        stride_realtime_in_callback() = false; // Don't report the report
+        stride_realtime_message("STRIDE_REALTIME: ");
+        stride_realtime_message(function);
+        stride_realtime_message(" called from the audio callback.\n");
+        raise(SIGTRAP);
+        stride_realtime_in_callback() = true;
+    }
+}
+
+extern "C" {
+void *malloc(size_t size) {
+    stride_realtime_violation("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    stride_realtime_violation("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    stride_realtime_violation("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void *pointer) {
+    stride_realtime_violation("free");
+    __libc_free(pointer);
+}
+
+int pthread_mutex_lock(pthread_mutex_t *mutex) {
+    typedef int (*LockFunction)(pthread_mutex_t *);
+    static LockFunction lock = nullptr; // No guard variable, it may lock
+    if (!lock) {
+        lock = (LockFunction) dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    }
+    stride_realtime_violation("pthread_mutex_lock");
+    return lock(mutex);
+}
+}
+#endif
+
+#define STRIDE_REALTIME_SETUP() stride_realtime_setup()
+#define STRIDE_REALTIME_CALLBACK() StrideRealtimeScope _stride_realtime_scope
+
+#else
+
+#define STRIDE_REALTIME_SETUP()
+#define STRIDE_REALTIME_CALLBACK()
+
+#endif // STRIDE_REALTIME
+
+#endif // STRIDE_REALTIME_HPP
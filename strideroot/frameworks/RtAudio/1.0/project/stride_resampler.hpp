@@ -0,0 +1,120 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Polyphase FIR resampler used where a stream changes rate. The generated
+// code pushes every sample of the parent rate and asks for an output each
+// time the stream at the new rate runs. P/Q is the exact ratio between the
+// new and the parent rate, and output(phase) is the sample phase/P input
+// samples after the newest input (less the filter's fixed delay), so the
+// outputs of one period take ascending phases (see BaseCTemplate.rate_start()).
+// Only the filter phase needed for each output is evaluated.
+
+#ifndef STRIDE_RESAMPLER_HPP
+#define STRIDE_RESAMPLER_HPP
+
+#include <cmath>
+
+template<int P, int Q, int Taps>
+class StrideResampler {
+    static_assert(Taps % 4 == 0, "Taps per phase must be a multiple of 4");
+public:
+    StrideResampler() : m_pos(0) {
+        table(); // Build the coefficients before processing starts
+        for (int i = 0; i < 2 * Taps; i++) {
+            m_history[i] = 0.0f;
+        }
+    }
+
+    inline void push(float x) {
+        m_pos = (m_pos == 0 ? Taps : m_pos) - 1;
+        // The history is stored twice so the newest Taps samples are always contiguous
+        m_history[m_pos] = x;
+        m_history[m_pos + Taps] = x;
+    }
+
+    inline float output(int phase) const {
+        const float *c = table().coeffs[phase];
+        const float *x = m_history + m_pos;
+        // Four independent sums let the compiler use vector instructions
+        // without reordering floating point additions
+        float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+        for (int k = 0; k < Taps; k += 4) {
+            a0 += c[k] * x[k];
+            a1 += c[k + 1] * x[k + 1];
+            a2 += c[k + 2] * x[k + 2];
+            a3 += c[k + 3] * x[k + 3];
+        }
+        return (a0 + a1) + (a2 + a3);
+    }
+
+private:
+    struct Table {
+        alignas(32) float coeffs[P][Taps];
+
+        // Blackman windowed sinc, cut off below the lower of the two Nyquist
+        // frequencies. Each phase is normalized to unity gain at DC.
+        Table() {
+            const double pi = 3.14159265358979323846;
+            const int length = Taps * P;
+            const double cutoff = 0.5 * 0.92 / (P > Q ? P : Q); // In cycles per prototype sample
+            const double center = (length - 1) / 2.0;
+            for (int phase = 0; phase < P; phase++) {
+                double sum = 0.0;
+                for (int k = 0; k < Taps; k++) {
+                    int j = k * P + phase;
+                    double t = j - center;
+                    double sinc = t == 0.0 ? 1.0 : std::sin(2.0 * pi * cutoff * t) / (2.0 * pi * cutoff * t);
+                    double window = 0.42 - 0.5 * std::cos(2.0 * pi * (j + 0.5) / length)
+                            + 0.08 * std::cos(4.0 * pi * (j + 0.5) / length);
+                    coeffs[phase][k] = (float) (sinc * window);
+                    sum += sinc * window;
+                }
+                for (int k = 0; k < Taps; k++) {
+                    coeffs[phase][k] = (float) (coeffs[phase][k] / sum);
+                }
+            }
+        }
+    };
+
+    // Computed once per ratio and filter length, on first use
+    static const Table &table() {
+        static const Table t;
+        return t;
+    }
+
+    alignas(32) float m_history[2 * Taps];
+    int m_pos;
+};
+
+#endif // STRIDE_RESAMPLER_HPP
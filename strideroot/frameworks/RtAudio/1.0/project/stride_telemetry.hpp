@@ -0,0 +1,423 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+// Real-time telemetry for the generated audio callback. Nothing in here
+// blocks, allocates or does I/O on the audio thread:
+//  - StrideTelemetryBlock times each callback and updates counters and
+//    histograms that only the audio thread writes (relaxed load + store).
+//  - Debug prints are aggregated per call site during a block and, at most
+//    STRIDE_DEBUG_PRINT_RATE times per second per site, pushed onto a bounded
+//    lock-free queue.
+// A non real-time thread started by stride_telemetry_start() drains the queue
+// to stdout and reports xruns and load to stderr.
+
+#ifndef STRIDE_TELEMETRY_HPP
+#define STRIDE_TELEMETRY_HPP
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <cstddef>
+
+#ifndef STRIDE_DEBUG_PRINT_RATE
+#define STRIDE_DEBUG_PRINT_RATE 20 // Messages per second per site
+#endif
+
+#ifndef STRIDE_DEBUG_QUEUE_SIZE
+#define STRIDE_DEBUG_QUEUE_SIZE 1024 // Must be a power of two
+#endif
+
+#ifndef STRIDE_DEBUG_MAX_SITES
+#define STRIDE_DEBUG_MAX_SITES 256
+#endif
+
+#ifndef STRIDE_TELEMETRY_INTERVAL_MS
+#define STRIDE_TELEMETRY_INTERVAL_MS 0 // 0 only reports on exit
+#endif
+
+#define STRIDE_TELEMETRY_LOAD_BUCKETS 11 // 10% steps, last bucket is overload
+#define STRIDE_TELEMETRY_TIME_BUCKETS 20 // Powers of two in microseconds
+
+inline int64_t stride_telemetry_now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Counters written by a single thread and read by others.
+template<typename T>
+inline void stride_telemetry_add(std::atomic<T> &counter, T value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+// Debug print sites -------------------------------------------------------
+// One per STRIDE_DEBUG_PRINT() in the generated code. Constant initialized so
+// the function-local static needs no guard on the audio thread.
+struct StrideDebugSite {
+    const char *label;
+    double last;
+    double minimum;
+    double maximum;
+    uint64_t count;
+    int64_t lastSent;
+    bool pending;
+    bool registered;
+};
+
+struct StrideDebugMessage {
+    const StrideDebugSite *site;
+    double value;
+    double minimum;
+    double maximum;
+    uint64_t count;
+};
+
+// Bounded multi-producer single-consumer queue (Vyukov). Producers never wait:
+// if the queue is full the message is dropped and counted.
+class StrideDebugQueue {
+public:
+    StrideDebugQueue() {
+        for (size_t i = 0; i < STRIDE_DEBUG_QUEUE_SIZE; i++) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(const StrideDebugMessage &message) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        while (true) {
+            Cell &cell = m_cells[pos & (STRIDE_DEBUG_QUEUE_SIZE - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.message = message;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(StrideDebugMessage &message) {
+        Cell &cell = m_cells[m_head & (STRIDE_DEBUG_QUEUE_SIZE - 1)];
+        if (cell.sequence.load(std::memory_order_acquire) != m_head + 1) {
+            return false;
+        }
+        message = cell.message;
+        cell.sequence.store(m_head + STRIDE_DEBUG_QUEUE_SIZE, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        StrideDebugMessage message;
+    };
+    Cell m_cells[STRIDE_DEBUG_QUEUE_SIZE];
+    std::atomic<size_t> m_tail {0};
+    size_t m_head {0};
+};
+
+// Telemetry state -----------------------------------------------------------
+struct StrideTelemetry {
+    // Written by the audio thread only
+    std::atomic<uint64_t> callbacks {0};
+    std::atomic<uint64_t> frames {0};
+    std::atomic<uint64_t> xruns {0};
+    std::atomic<uint64_t> totalNs {0};
+    std::atomic<uint64_t> maxBlockNs {0};
+    std::atomic<uint32_t> lastLoad {0}; // Percent
+    std::atomic<uint32_t> maxLoad {0};
+    std::atomic<uint64_t> loadHistogram[STRIDE_TELEMETRY_LOAD_BUCKETS];
+    std::atomic<uint64_t> timeHistogram[STRIDE_TELEMETRY_TIME_BUCKETS];
+
+    std::atomic<uint64_t> droppedMessages {0};
+    std::atomic<StrideDebugSite *> sites[STRIDE_DEBUG_MAX_SITES];
+    std::atomic<int> numSites {0};
+    StrideDebugQueue queue;
+
+    double nsPerFrame {0.0};
+    std::atomic<bool> running {false};
+    std::thread drainThread;
+
+    static StrideTelemetry &instance() {
+        static StrideTelemetry telemetry;
+        return telemetry;
+    }
+
+    StrideTelemetry() {
+        for (int i = 0; i < STRIDE_TELEMETRY_LOAD_BUCKETS; i++) {
+            loadHistogram[i].store(0, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < STRIDE_TELEMETRY_TIME_BUCKETS; i++) {
+            timeHistogram[i].store(0, std::memory_order_relaxed);
+        }
+        for (int i = 0; i < STRIDE_DEBUG_MAX_SITES; i++) {
+            sites[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    void recordBlock(int64_t elapsedNs, unsigned int nFrames, bool xrun) {
+        stride_telemetry_add<uint64_t>(callbacks, 1);
+        stride_telemetry_add<uint64_t>(frames, nFrames);
+        stride_telemetry_add<uint64_t>(totalNs, elapsedNs);
+        if (xrun) {
+            stride_telemetry_add<uint64_t>(xruns, 1);
+        }
+        if ((uint64_t) elapsedNs > maxBlockNs.load(std::memory_order_relaxed)) {
+            maxBlockNs.store(elapsedNs, std::memory_order_relaxed);
+        }
+        if (nsPerFrame > 0.0 && nFrames > 0) {
+            uint32_t load = (uint32_t) (100.0 * elapsedNs / (nsPerFrame * nFrames));
+            lastLoad.store(load, std::memory_order_relaxed);
+            if (load > maxLoad.load(std::memory_order_relaxed)) {
+                maxLoad.store(load, std::memory_order_relaxed);
+            }
+            int bucket = load / 10;
+            stride_telemetry_add<uint64_t>(loadHistogram[bucket < STRIDE_TELEMETRY_LOAD_BUCKETS ? bucket : STRIDE_TELEMETRY_LOAD_BUCKETS - 1], 1);
+        }
+        int bucket = 0;
+        for (int64_t us = elapsedNs / 1000; us > 0 && bucket < STRIDE_TELEMETRY_TIME_BUCKETS - 1; us >>= 1) {
+            bucket++;
+        }
+        stride_telemetry_add<uint64_t>(timeHistogram[bucket], 1);
+    }
+
+    // Sends the aggregated value of a site if its rate limit allows it.
+    void flushSite(StrideDebugSite &site, int64_t now, bool force) {
+        if (!site.pending) {
+            return;
+        }
+        if (!force && now - site.lastSent < 1000000000ll / STRIDE_DEBUG_PRINT_RATE) {
+            return;
+        }
+        StrideDebugMessage message = {&site, site.last, site.minimum, site.maximum, site.count};
+        if (!queue.push(message)) {
+            stride_telemetry_add<uint64_t>(droppedMessages, 1);
+        }
+        site.pending = false;
+        site.count = 0;
+        site.lastSent = now;
+    }
+
+    void registerSite(StrideDebugSite &site) {
+        site.registered = true;
+        int index = numSites.fetch_add(1, std::memory_order_relaxed);
+        if (index < STRIDE_DEBUG_MAX_SITES) {
+            sites[index].store(&site, std::memory_order_release);
+        }
+    }
+
+    void drain() {
+        StrideDebugMessage message;
+        while (queue.pop(message)) {
+            if (message.count > 1) { // Values aggregated over a block or a rate limited period
+                std::cout << message.value << " (" << message.minimum << ".." << message.maximum
+                          << ", n=" << message.count << ")" << std::endl;
+            } else {
+                std::cout << message.value << std::endl;
+            }
+        }
+    }
+
+    void report(std::ostream &out) {
+        uint64_t numCallbacks = callbacks.load(std::memory_order_relaxed);
+        if (numCallbacks == 0) {
+            return;
+        }
+        out << "Audio callbacks: " << numCallbacks
+            << " xruns: " << xruns.load(std::memory_order_relaxed)
+            << " mean block: " << totalNs.load(std::memory_order_relaxed) / numCallbacks / 1000.0 << "us"
+            << " max block: " << maxBlockNs.load(std::memory_order_relaxed) / 1000.0 << "us"
+            << " load: " << lastLoad.load(std::memory_order_relaxed) << "%"
+            << " max load: " << maxLoad.load(std::memory_order_relaxed) << "%";
+        uint64_t dropped = droppedMessages.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            out << " dropped debug messages: " << dropped;
+        }
+        out << std::endl;
+    }
+
+    void reportHistograms(std::ostream &out) {
+        if (callbacks.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        out << "Load histogram:" << std::endl;
+        for (int i = 0; i < STRIDE_TELEMETRY_LOAD_BUCKETS; i++) {
+            uint64_t count = loadHistogram[i].load(std::memory_order_relaxed);
+            if (count > 0) {
+                if (i < STRIDE_TELEMETRY_LOAD_BUCKETS - 1) {
+                    out << std::setw(5) << i * 10 << "-" << std::setw(3) << i * 10 + 10 << "% ";
+                } else {
+                    out << std::setw(9) << ">100" << "% ";
+                }
+                out << count << std::endl;
+            }
+        }
+        out << "Block time histogram:" << std::endl;
+        for (int i = 0; i < STRIDE_TELEMETRY_TIME_BUCKETS; i++) {
+            uint64_t count = timeHistogram[i].load(std::memory_order_relaxed);
+            if (count > 0) {
+                out << std::setw(8) << "<" << (1 << i) << "us " << count << std::endl;
+            }
+        }
+    }
+};
+
+// Processing thread state. Sites posted to while a block is open are only
+// aggregated; they are flushed when the block closes.
+struct StrideTelemetryThreadState {
+    bool inBlock;
+    int numDirty;
+    StrideDebugSite *dirty[STRIDE_DEBUG_MAX_SITES];
+};
+
+inline StrideTelemetryThreadState &stride_telemetry_thread_state() {
+    static thread_local StrideTelemetryThreadState state = {false, 0, {}};
+    return state;
+}
+
+inline void stride_debug_post(StrideDebugSite &site, double value) {
+    StrideTelemetry &telemetry = StrideTelemetry::instance();
+    if (!site.registered) {
+        telemetry.registerSite(site);
+    }
+    if (site.pending) {
+        site.minimum = value < site.minimum ? value : site.minimum;
+        site.maximum = value > site.maximum ? value : site.maximum;
+    } else {
+        site.minimum = site.maximum = value;
+        site.pending = true;
+        StrideTelemetryThreadState &state = stride_telemetry_thread_state();
+        if (state.inBlock && state.numDirty < STRIDE_DEBUG_MAX_SITES) {
+            state.dirty[state.numDirty++] = &site;
+        }
+    }
+    site.last = value;
+    site.count++;
+    if (!stride_telemetry_thread_state().inBlock) {
+        telemetry.flushSite(site, stride_telemetry_now(), false);
+    }
+}
+
+#define STRIDE_DEBUG_PRINT(value) \
+    do { \
+        static StrideDebugSite _stride_debug_site = {#value, 0.0, 0.0, 0.0, 0, 0, false, false}; \
+        stride_debug_post(_stride_debug_site, value); \
+    } while (0)
+
+// Times one audio callback. Place at the top of the callback.
+class StrideTelemetryBlock {
+public:
+    StrideTelemetryBlock(unsigned int nFrames, bool xrun) :
+        m_start(stride_telemetry_now()), m_frames(nFrames), m_xrun(xrun) {
+        stride_telemetry_thread_state().inBlock = true;
+    }
+
+    ~StrideTelemetryBlock() {
+        int64_t end = stride_telemetry_now();
+        StrideTelemetry &telemetry = StrideTelemetry::instance();
+        telemetry.recordBlock(end - m_start, m_frames, m_xrun);
+        StrideTelemetryThreadState &state = stride_telemetry_thread_state();
+        int remaining = 0;
+        for (int i = 0; i < state.numDirty; i++) {
+            telemetry.flushSite(*state.dirty[i], end, false);
+            if (state.dirty[i]->pending) { // Rate limited, keep aggregating
+                state.dirty[remaining++] = state.dirty[i];
+            }
+        }
+        state.numDirty = remaining;
+        state.inBlock = false;
+    }
+
+private:
+    int64_t m_start;
+    unsigned int m_frames;
+    bool m_xrun;
+};
+
+// Called from the generated initialization code before audio starts
+inline void stride_telemetry_start(double sampleRate) {
+    StrideTelemetry &telemetry = StrideTelemetry::instance();
+    telemetry.nsPerFrame = sampleRate > 0 ? 1e9 / sampleRate : 0.0;
+    telemetry.running.store(true);
+    telemetry.drainThread = std::thread([]() {
+        StrideTelemetry &telemetry = StrideTelemetry::instance();
+        uint64_t reportedXruns = 0;
+        int64_t lastReport = stride_telemetry_now();
+        while (telemetry.running.load()) {
+            telemetry.drain();
+            uint64_t xruns = telemetry.xruns.load(std::memory_order_relaxed);
+            if (xruns != reportedXruns) {
+                std::cerr << "Stream over/underflow detected (" << xruns << " total)." << std::endl;
+                reportedXruns = xruns;
+            }
+            if (STRIDE_TELEMETRY_INTERVAL_MS > 0
+                    && stride_telemetry_now() - lastReport >= STRIDE_TELEMETRY_INTERVAL_MS * 1000000ll) {
+                telemetry.report(std::cerr);
+                lastReport = stride_telemetry_now();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    });
+}
+
+// Called from the generated cleanup code once audio has stopped. Sends the
+// last value of every site that is still being rate limited.
+inline void stride_telemetry_stop() {
+    StrideTelemetry &telemetry = StrideTelemetry::instance();
+    if (telemetry.running.exchange(false)) {
+        telemetry.drainThread.join();
+    }
+    int numSites = telemetry.numSites.load();
+    int64_t now = stride_telemetry_now();
+    for (int i = 0; i < numSites && i < STRIDE_DEBUG_MAX_SITES; i++) {
+        StrideDebugSite *site = telemetry.sites[i].load(std::memory_order_acquire);
+        if (site) {
+            telemetry.flushSite(*site, now, true);
+        }
+    }
+    telemetry.drain();
+    telemetry.report(std::cerr);
+    telemetry.reportHistograms(std::cerr);
+}
+
+#endif // STRIDE_TELEMETRY_HPP
@@ -1,5 +1,7 @@
 
 #include "RtAudio.h"
+#include "stride_telemetry.hpp"
+#include "stride_realtime.hpp"
 #include <iostream>
 #include <cstdlib>
 #include <cstring>
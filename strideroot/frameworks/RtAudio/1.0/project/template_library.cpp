@@ -0,0 +1,113 @@
+#include "RtAudio.h"
+#include "stride_telemetry.hpp"
+#include "stride_program.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+
+//[[Includes]]
+//[[/Includes]]
+
+// All declarations and instances are members, so each instance of the
+// program has its own state in one contiguous, cache line aligned block.
+struct alignas(64) StrideProgram {
+
+//[[Declarations]]
+//[[/Declarations]]
+
+//[[Instances]]
+//[[/Instances]]
+
+
+//[[Processing]]
+//[[/Processing]]
+
+void initialize() {
+//[[Initialization]]
+
+//[[/Initialization]]
+}
+
+void cleanup() {
+//[[Cleanup]]
+//[[/Cleanup]]
+}
+
+};
+
+static void *stride_aligned_alloc(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+  return _aligned_malloc(size, alignment);
+#else
+  void *memory = nullptr;
+  if (posix_memalign(&memory, alignment, size) != 0) {
+    return nullptr;
+  }
+  return memory;
+#endif
+}
+
+static void stride_aligned_free(void *memory)
+{
+#ifdef _WIN32
+  _aligned_free(memory);
+#else
+  free(memory);
+#endif
+}
+
+extern "C" {
+
+StrideProgram *stride_create(void)
+{
+  void *memory = stride_aligned_alloc(sizeof(StrideProgram), alignof(StrideProgram));
+  if (!memory) {
+    return nullptr;
+  }
+  StrideProgram *program = new (memory) StrideProgram;
+  program->initialize();
+  return program;
+}
+
+void stride_process_block(StrideProgram *program, const float *in, float *out, unsigned int frames)
+{
+  program->audio_buffer_process(in, out, frames);
+}
+
+void stride_reset(StrideProgram *program)
+{
+  program->cleanup();
+  program->~StrideProgram();
+  new (program) StrideProgram;
+  program->initialize();
+}
+
+void stride_destroy(StrideProgram *program)
+{
+  if (!program) {
+    return;
+  }
+  program->cleanup();
+  program->~StrideProgram();
+  stride_aligned_free(program);
+}
+
+int stride_num_inputs(void)
+{
+  return NUM_IN_CHANNELS;
+}
+
+int stride_num_outputs(void)
+{
+  return NUM_OUT_CHANNELS;
+}
+
+int stride_sample_rate(void)
+{
+  return STRIDE_SAMPLE_RATE;
+}
+
+}
@@ -46,7 +46,9 @@ except ImportError:
 import platform
 import shutil
 import os
+import multiprocessing
 from strideplatform import GeneratorBase
+from buildcache import BuildCache, sync_tree
 
 class ExternalProcess(object):
     def __init__(self):
@@ -174,6 +176,99 @@ class Generator(GeneratorBase):
         else:
             self.templates.properties['block_size'] = 512
 
+        # Benchmark mode. Used together with the testing domain, it times
+        # audio_buffer_process over synthetic input instead of printing output.
+        self.defines = []
+        if self.config and self.config.get('Benchmark', False):
+            self.defines = ['-DSTRIDE_BENCHMARK',
+                            '-DSTRIDE_BENCHMARK_BLOCK_SIZE=%i'%int(self.templates.properties['block_size']),
+                            '-DSTRIDE_BENCHMARK_BLOCKS=%i'%int(self.config.get('BenchmarkBlocks', 1000)),
+                            '-DSTRIDE_BENCHMARK_WARMUP=%i'%int(self.config.get('BenchmarkWarmup', 3)),
+                            '-DSTRIDE_BENCHMARK_REPETITIONS=%i'%int(self.config.get('BenchmarkRepetitions', 10))]
+
+        # Telemetry runtime (stride_telemetry.hpp). Debug prints are rate limited
+        # per call site and load reports can be printed periodically.
+        if self.config and 'DebugPrintRate' in self.config:
+            self.defines.append('-DSTRIDE_DEBUG_PRINT_RATE=%i'%int(self.config['DebugPrintRate']))
+        if self.config and 'TelemetryInterval' in self.config: # in seconds
+            self.defines.append('-DSTRIDE_TELEMETRY_INTERVAL_MS=%i'%int(float(self.config['TelemetryInterval']) * 1000))
+
+        # Profiling mode. Instruments streams and module processing functions.
+        # The profile is printed to stderr on exit or on SIGUSR1.
+        if self.config and self.config.get('Profile', False):
+            self.templates.profiling = True
+
+        # Cost below which module processing functions are forced inline
+        if self.config and 'InlineThreshold' in self.config:
+            self.templates.inline_threshold = int(self.config['InlineThreshold'])
+
+        # Parallel mode. Streams of the audio domain that share no signals are
+        # grouped and run on a pool of pinned worker threads (stride_parallel.hpp).
+        # Set to true to use all cores or to the number of worker threads.
+        if self.config and self.config.get('Parallel', False):
+            if type(self.config['Parallel']) == bool:
+                threads = max(1, multiprocessing.cpu_count() - 1)
+            else:
+                threads = int(self.config['Parallel'])
+            if self.templates.profiling:
+                self.log("Parallel mode is not available when profiling.")
+            elif threads > 0:
+                self.templates.parallel_threads = threads
+                self.defines.append('-DSTRIDE_PARALLEL_THREADS=%i'%threads)
+
+        # Pipeline mode. The audio domain's streams are split into this many
+        # stages that run at the same time, each one block behind the previous
+        # one (stride_pipeline.hpp). Adds Pipeline - 1 blocks of latency.
+        if self.config and int(self.config.get('Pipeline', 0)) > 1:
+            stages = int(self.config['Pipeline'])
+            if self.templates.profiling:
+                self.log("Pipeline mode is not available when profiling.")
+            else:
+                self.templates.pipeline_stages = stages
+                self.templates.parallel_threads = max(self.templates.parallel_threads, stages - 1)
+                self.defines = [d for d in self.defines if not d.startswith('-DSTRIDE_PARALLEL_THREADS=')]
+                self.defines += ['-DSTRIDE_PARALLEL_THREADS=%i'%self.templates.parallel_threads,
+                                 '-DSTRIDE_PIPELINE_FRAMES=%i'%int(self.templates.properties['block_size'])]
+
+        # Library mode. All program state is gathered in one StrideProgram
+        # object behind the C interface in stride_program.h, and a shared
+        # library is built instead of an application. Only the audio domain
+        # is supported, as the processing is driven by the host.
+        self.library = bool(self.config and self.config.get('Library', False))
+        self.unsupported_domains = [] # Domains other than the audio domain, found in library mode
+        if self.library:
+            self.defines += ['-DSTRIDE_LIBRARY',
+                             '-DSTRIDE_SAMPLE_RATE=%i'%int(self.templates.properties['sample_rate'])]
+            # Profile sites are static arrays, which can't be members
+            self.templates.profiling = False
+            if platform.system() == "Darwin":
+                self.target_name = 'libstride_program.dylib'
+            else:
+                self.target_name = 'libstride_program.so'
+
+        # Realtime mode. Locks memory and pre-faults the heap before the stream
+        # is opened, and runs the audio callback with SCHED_FIFO and
+        # flush-to-zero (stride_realtime.hpp). Set to true or to a dictionary
+        # with Priority, WorkerPriority, CPU, HeapMB and Debug. Parallel and
+        # pipeline workers only get SCHED_FIFO if WorkerPriority is above 0,
+        # as they spin for a while after each block. Debug traps calls to
+        # malloc, free and pthread_mutex_lock made from the audio callback.
+        self.realtime_debug = False
+        if self.config and self.config.get('Realtime', False):
+            realtime = self.config['Realtime']
+            if type(realtime) != dict:
+                realtime = {}
+            if self.library:
+                self.log("Realtime mode is not available in library mode. The host owns the audio thread.")
+            else:
+                self.defines += ['-DSTRIDE_REALTIME',
+                                 '-DSTRIDE_REALTIME_PRIORITY=%i'%int(realtime.get('Priority', 80)),
+                                 '-DSTRIDE_REALTIME_WORKER_PRIORITY=%i'%int(realtime.get('WorkerPriority', 0)),
+                                 '-DSTRIDE_REALTIME_CPU=%i'%int(realtime.get('CPU', -1)),
+                                 '-DSTRIDE_REALTIME_HEAP_MB=%i'%int(realtime.get('HeapMB', 16))]
+                if realtime.get('Debug', False):
+                    self.realtime_debug = True
+                    self.defines.append('-DSTRIDE_REALTIME_DEBUG')
 
     def generate_code(self):
         # Generate code from tree
@@ -183,19 +278,45 @@ class Generator(GeneratorBase):
         #domain = "AudioDomain"
         code = self.platform.generate_code(self.tree)
 
+        if self.library:
+            # Only the audio domain is driven by stride_process_block(). The
+            # code of other domains can't live in StrideProgram
+            platform_domain = self.platform.get_platform_domain()
+            self.unsupported_domains = [domain for domain, domain_code in code['domain_code'].items()
+                                        if domain and domain != platform_domain
+                                        and (domain_code['processing_code'] or domain_code['init_code'])]
+            if len(self.unsupported_domains) > 0:
+                # Raised so the build fails (build.py exits with an error)
+                raise ValueError("Library mode only supports the %s domain! Program also uses: %s"
+                                 %(platform_domain, ', '.join(self.unsupported_domains)))
+
         #var_declaration = ''.join(['double stream_%02i;\n'%i for i in range(stream_index)])
         #declare_code = var_declaration + declare_code
 
 
         self.out_file = self.out_dir + "/main.cpp"
-        shutil.copyfile(self.project_dir + "/template.cpp", self.out_file)
-        if os.path.isdir(self.out_dir + "/rtaudio"):
-            shutil.rmtree(self.out_dir + "/rtaudio")
+        if self.library:
+            shutil.copyfile(self.project_dir + "/template_library.cpp", self.out_file)
+            shutil.copyfile(self.project_dir + "/stride_program.h", self.out_dir + "/stride_program.h")
+        else:
+            shutil.copyfile(self.project_dir + "/template.cpp", self.out_file)
         if os.path.isdir(self.project_dir + "/rtaudio-4.1.2"):
-            shutil.copytree(self.project_dir + "/rtaudio-4.1.2", self.out_dir + "/rtaudio")
+            if not sync_tree(self.project_dir + "/rtaudio-4.1.2", self.out_dir + "/rtaudio"):
+                self.log("RtAudio sources unchanged. Not copying.")
         else:
             self.log("RtAudio 4.1.2 required. Not copying to project.")
 
+        shutil.copyfile(self.project_dir + "/stride_telemetry.hpp", self.out_dir + "/stride_telemetry.hpp")
+        shutil.copyfile(self.project_dir + "/stride_realtime.hpp", self.out_dir + "/stride_realtime.hpp")
+        if self.templates.profiling:
+            shutil.copyfile(self.project_dir + "/stride_profiler.hpp", self.out_dir + "/stride_profiler.hpp")
+        if self.templates.resampling_used:
+            shutil.copyfile(self.project_dir + "/stride_resampler.hpp", self.out_dir + "/stride_resampler.hpp")
+        if self.templates.parallel_threads > 0:
+            shutil.copyfile(self.project_dir + "/stride_parallel.hpp", self.out_dir + "/stride_parallel.hpp")
+        if self.templates.pipeline_stages > 1:
+            shutil.copyfile(self.project_dir + "/stride_pipeline.hpp", self.out_dir + "/stride_pipeline.hpp")
+
         self.write_code(code,self.out_file)
 
         self.make_code_pretty()
@@ -229,7 +350,13 @@ class Generator(GeneratorBase):
 
         os.chdir(self.out_dir)
 
-        if platform.system() == "Windows":
+        if self.library and len(self.unsupported_domains) > 0:
+            raise ValueError("Library not built. Library mode only supports the audio domain.")
+
+        elif platform.system() == "Windows" and self.library:
+            self.log("Library mode is not supported on Windows!")
+
+        elif platform.system() == "Windows":
 
             source_files = [self.out_file, self.out_dir + "/rtaudio/RtAudio.cpp"]
             cpp_compiler = "c++"
@@ -243,7 +370,7 @@ class Generator(GeneratorBase):
                          "-D__WINDOWS_WASAPI__",
                          "-Irtaudio/include"
                          "-o " + short_f + ".o",
-                         "-c "+ f]
+                         "-c "+ f] + self.defines
 
                 args = [cpp_compiler] + flags
 
@@ -274,7 +401,7 @@ class Generator(GeneratorBase):
 
             source_files = [self.out_file]
             modules = []
-            if os.path.exists(self.out_dir + "/rtaudio/RtAudio.cpp"):
+            if not self.library and os.path.exists(self.out_dir + "/rtaudio/RtAudio.cpp"):
                 source_files.append(self.out_dir + "/rtaudio/RtAudio.cpp")
                 modules = self.templates.properties['rtaudio_api']
 #                modules = ['alsa']
@@ -304,23 +431,20 @@ class Generator(GeneratorBase):
                 defines += jack_defines
                 link_flags = jack_link_flags
 
-            for f in source_files:
-                short_f = f[f.rindex("/") + 1:]
-                args = [cpp_compiler,
+            compile_flags = [
 #                        "-I" + self.platform_dir + "/include",
                         "-I"+ self.out_dir + "/rtaudio",
                         "-O3" ,
                         "-std=c++11",
                         "-DNDEBUG"]
-                args += defines
-                args += ["-o" + short_f + ".o",
-                         "-c",
-                         f]
+            compile_flags += defines + self.defines
+            if self.library:
+                compile_flags.append("-fPIC")
 
-                self.log(args)
-
-                outtext = ck_out(args)
-                self.log(outtext)
+            cache = self.build_cache()
+            object_files = [f[f.rindex("/") + 1:] + ".o" for f in source_files]
+            cache.compile_all(cpp_compiler,
+                              [(compile_flags, f, o) for f, o in zip(source_files, object_files)])
 
              # Link ------------------------
             args = [cpp_compiler,
@@ -330,42 +454,40 @@ class Generator(GeneratorBase):
                     ]
 
 
-            args += [f[f.rindex("/") + 1:] + ".o" for f in source_files]
+            if self.library:
+                args.append("-shared")
+            args += object_files
             args += ["-o" + self.out_dir + "/" + self.target_name]
             args += link_flags
+            if self.templates.parallel_threads > 0 and not '-lpthread' in link_flags:
+                args.append('-lpthread')
+            if self.realtime_debug:
+                args.append('-ldl')
 
             args += self.build_flags + self.link_flags
 
-            self.log(args)
-
-            outtext = ck_out(args)
-
-            self.log(outtext)
+            self.link(cache, args, object_files)
 
 
         elif platform.system() == "Darwin":
 
-            source_files = [self.out_file, self.out_dir + "/rtaudio/RtAudio.cpp"]
+            source_files = [self.out_file]
+            if not self.library:
+                source_files.append(self.out_dir + "/rtaudio/RtAudio.cpp")
 
             cpp_compiler = "/usr/bin/c++"
 
-            for f in source_files:
-                short_f = f[f.rindex("/") + 1:]
-                args = [cpp_compiler,
-                        "-I"+ self.out_dir + "/rtaudio",
-                        "-O3" ,
-                        "-std=c++11",
-                        "-DNDEBUG",
-                        "-D__MACOSX_CORE__",
-                        "-Irtaudio",
-                         "-o" + short_f + ".o",
-                         "-c",
-                         f]
+            compile_flags = ["-I"+ self.out_dir + "/rtaudio",
+                             "-O3" ,
+                             "-std=c++11",
+                             "-DNDEBUG",
+                             "-D__MACOSX_CORE__",
+                             "-Irtaudio"] + self.defines
 
-                self.log(args)
-
-                outtext = ck_out(args)
-                self.log(outtext)
+            cache = self.build_cache()
+            object_files = [f[f.rindex("/") + 1:] + ".o" for f in source_files]
+            cache.compile_all(cpp_compiler,
+                              [(compile_flags, f, o) for f, o in zip(source_files, object_files)])
 
             # Link ------------------------
             args = [cpp_compiler,
@@ -377,27 +499,59 @@ class Generator(GeneratorBase):
                     "-Wl,-headerpad_max_install_names"]
 
 
-            args += [f[f.rindex("/") + 1:] + ".o" for f in source_files]
-            args += ["-o" + self.out_dir + "/" + self.target_name,
-                    "-framework CoreFoundation",
-                    "-framework CoreAudio",
-                    "-lpthread"
-                    ]
+            args += object_files
+            if self.library:
+                args += ["-dynamiclib",
+                         "-o" + self.out_dir + "/" + self.target_name]
+            else:
+                args += ["-o" + self.out_dir + "/" + self.target_name,
+                        "-framework CoreFoundation",
+                        "-framework CoreAudio",
+                        "-lpthread"
+                        ]
 
             args += self.build_flags + self.link_flags
 
-            self.log(args)
-
-            # ck_out didn't work properly on OS X
-            os.system(' '.join(args))
+            key = cache.link_key(args, object_files)
+            if cache.is_linked(self.out_dir + "/" + self.target_name, key):
+                self.log("Objects unchanged. Not linking.")
+            else:
+                self.log(args)
+                # ck_out didn't work properly on OS X
+                if os.system(' '.join(args)) == 0:
+                    cache.store_link_key(self.out_dir + "/" + self.target_name, key)
 
         else:
             self.log("Platform '%s' not supported!"%platform.system())
 
         self.log("Platform code compilation finished!")
 
+    def build_cache(self):
+        # Objects are shared across projects. Set BuildJobs to limit parallel compiles
+        jobs = int(self.config['BuildJobs']) if self.config and 'BuildJobs' in self.config else None
+        return BuildCache(self.config.get('BuildCacheDir') if self.config else None, jobs, self.log)
+
+    def link(self, cache, args, object_files):
+        key = cache.link_key(args, object_files)
+        if cache.is_linked(self.out_dir + "/" + self.target_name, key):
+            self.log("Objects unchanged. Not linking.")
+            return
+        self.log(args)
+        outtext = ck_out(args)
+        self.log(outtext)
+        cache.store_link_key(self.out_dir + "/" + self.target_name, key)
+
+    def run_command(self):
+        if self.library: # Nothing to run, run() reports the library
+            return None
+        return [self.out_dir + "/" + self.target_name], self.out_dir
+
     def run(self):
 
+        if self.library:
+            if len(self.unsupported_domains) == 0:
+                self.log("Built library: " + self.out_dir + "/" + self.target_name)
+            return
         os.chdir(self.out_dir)
         self.log("Running: " + self.out_dir + "/" + self.target_name)
         self.log("Running in directory: " + self.out_dir)
@@ -41,6 +41,7 @@ class Templates(BaseCTemplate):
         super(Templates, self).__init__()
 
         self.framework = "RtAudio"
+        self.resampling = True
 
     def process_code(self, code):
         code = code.replace("%%device%%", str(self.properties['audio_device']))
@@ -42,6 +42,7 @@ except:
     unicode = str # for python 3
 
 import re
+from fractions import Fraction
 
 class BaseCTemplate(object):
     def __init__(self):
@@ -54,6 +55,32 @@ class BaseCTemplate(object):
         self.rate_counter = 0
         self.domain_rate = None
 
+        # Band-limited resampling at rate changes (see resampler_code()).
+        # Platforms that ship stride_resampler.hpp enable it.
+        self.resampling = False
+        self.resampling_used = False
+        self.resampling_max_factor = 8 # Larger ratios are control rates and hold values
+        self.resampling_presets = {'low': 8, 'medium': 16, 'high': 32} # Taps per phase
+
+        # Profiling instrumentation (see profile_scope_begin())
+        self.profiling = False
+        self.profile_sites = []
+
+        # Module processing functions are forced inline in the caller when
+        # cheaper than this (see processing_cost()) or when the module sets
+        # inline: on. Modules setting inline: off are never inlined.
+        self.inline_threshold = 40
+        self.inline_used = False
+
+        # Independent streams of a domain are run on this many worker threads
+        # besides the caller (see parallel_code()). 0 runs them serially.
+        self.parallel_threads = 0
+        self.parallel_used = False
+
+        # The domain's streams are split into this many pipeline stages, each
+        # a block behind the previous one (see pipeline_code()).
+        self.pipeline_stages = 0
+
         self.str_true = "true"
         self.str_false = "false"
         self.stream_begin_code = '// Starting stream %02i -------------------------\n ' #{\n'
@@ -105,6 +132,139 @@ public:
             marker = "//#line " + str(line) + ' "' + filename + '"\n'
         return marker
 
+    def reset(self):
+        ''' Clears all per-build state '''
+        self.__init__()
+
+    # Profiling ---------------------------------------------------------------
+    def profile_site(self, line, filename, label):
+        ''' Returns the index for a profiled code location, registering it if new '''
+        site = (filename, line, label)
+        if not site in self.profile_sites:
+            self.profile_sites.append(site)
+        return self.profile_sites.index(site)
+
+    def profile_scope_begin(self, line, filename, label):
+        if not self.profiling:
+            return ''
+        return '{ StrideProfileScope _stride_profile_scope(%i);\n'%self.profile_site(line, filename, label)
+
+    def profile_scope_end(self):
+        if not self.profiling:
+            return ''
+        return '}\n'
+
+    def profile_declarations_code(self):
+        if not self.profiling or len(self.profile_sites) == 0:
+            return ''
+        code = 'static const StrideProfileSite _stride_profile_sites[] = {\n'
+        for filename, line, label in self.profile_sites:
+            code += '    {"%s", %i, "%s"},\n'%(filename.replace('\\', '/'), line, label)
+        code += '};\n'
+        return code
+
+    def profile_initialization_code(self):
+        if not self.profiling or len(self.profile_sites) == 0:
+            return ''
+        return 'stride_profile_init(_stride_profile_sites, %i);\n'%len(self.profile_sites)
+
+    # Inlining ----------------------------------------------------------------
+    def processing_cost(self, code):
+        ''' Rough cost of a block of generated code. Calls and loops weigh more
+        than plain arithmetic, as they multiply the size of the inlined code.'''
+        code = re.sub(r'//[^\n]*', '', code)
+        cost = code.count(';')
+        cost += len(re.findall(r'[-+*/%<>=!&|^?]', code))
+        cost += 4 * len(re.findall(r'\b[A-Za-z_][\w:.]*\s*\(', code))
+        cost += 16 * len(re.findall(r'\b(for|while)\b', code))
+        return cost
+
+    def inline_attribute(self, inline, code):
+        ''' Returns the attribute for a module processing function. inline is
+        the module's inline property: True, False or None to use the cost.'''
+        if inline is None:
+            if self.processing_cost(code) > self.inline_threshold:
+                return ''
+            inline = True
+        self.inline_used = True
+        return 'STRIDE_ALWAYS_INLINE ' if inline else 'STRIDE_NEVER_INLINE '
+
+    def inline_macros_code(self):
+        return '''#if defined(__GNUC__)
+#define STRIDE_ALWAYS_INLINE inline __attribute__((always_inline))
+#define STRIDE_NEVER_INLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define STRIDE_ALWAYS_INLINE __forceinline
+#define STRIDE_NEVER_INLINE __declspec(noinline)
+#else
+#define STRIDE_ALWAYS_INLINE inline
+#define STRIDE_NEVER_INLINE
+#endif
+'''
+
+    # Parallel execution -----------------------------------------------------
+    def parallel_code(self, domain, clusters, cluster_function, cluster_call):
+        ''' Returns the cluster functions and the code that runs them on the
+        worker pool for one block. clusters is a list of processing code, one
+        entry per group of streams that shares no signals with the others.'''
+        self.parallel_used = True
+        functions_code = ''
+        cases_code = ''
+        for i, code in enumerate(clusters):
+            cluster_name = 'stride_cluster_%s_%i'%(domain, i)
+            functions_code += cluster_function.replace('%%clusterName%%', cluster_name).replace('%%domainCode%%', code) + '\n'
+            cases_code += '    case %i: %s break;\n'%(i, cluster_call.replace('%%clusterName%%', cluster_name))
+        run_code = 'stride_parallel_run(%i, [&](int cluster) {\n  switch (cluster) {\n%s  }\n});\n'%(len(clusters), cases_code)
+        return functions_code, run_code
+
+    def pipeline_code(self, domain, stages, cluster_function, cluster_call):
+        ''' Returns the globals, the declarations, the stage functions and the
+        code that runs them for one block. stages is a list of (code, loads, stores),
+        where loads and stores list the (name, type) of the signals passed
+        from earlier stages and to later ones. A loaded signal is a local
+        that hides the one written by the earlier stage.'''
+        self.parallel_used = True
+        globals_code = '#define STRIDE_PIPELINE_STAGES %i\n#include "stride_pipeline.hpp"\n'%len(stages)
+        declarations_code = ''
+        functions_code = ''
+        cases_code = ''
+        passed = []
+        for i, (code, loads, stores) in enumerate(stages):
+            stage_name = 'stride_stage_%s_%i'%(domain, i)
+            index = '[stride_pipe_slot_%i][stride_pipe_frame_%i]'%(i, i)
+            declarations_code += 'int stride_pipe_slot_%i = 0;\nint stride_pipe_frame_%i = 0;\n'%(i, i)
+            load_code = ''.join(['%s %s = stride_pipe_%s%s;\n'%(signal_type, name, name, index) for name, signal_type in loads])
+            store_code = ''.join(['stride_pipe_%s%s = %s;\n'%(name, index, name) for name, signal_type in stores])
+            store_code += 'stride_pipe_frame_%i++;\n'%i
+            for name, signal_type in stores:
+                if not name in passed:
+                    declarations_code += '%s stride_pipe_%s[STRIDE_PIPELINE_STAGES][STRIDE_PIPELINE_FRAMES];\n'%(signal_type, name)
+                    passed.append(name)
+            functions_code += cluster_function.replace('%%clusterName%%', stage_name).replace('%%domainCode%%', load_code + code + '\n' + store_code) + '\n'
+            cases_code += '''    case %i: {
+        stride_pipe_slot_%i = stride_pipeline.slot(%i);
+        stride_pipe_frame_%i = 0;
+        auto in = stride_pipeline.input(%i);
+        auto out = stride_pipeline.output(%i);
+        auto nBufferFrames = stride_pipeline.frames(%i);
+        if (nBufferFrames > 0) { %s }
+    } break;
+'''%(i, i, i, i, i, i, i, cluster_call.replace('%%clusterName%%', stage_name))
+        run_code = '''for (int chunk = 0; chunk < stride_pipeline.chunks(nBufferFrames); chunk++) {
+  stride_pipeline.begin(in, nBufferFrames, chunk);
+  stride_parallel_run(%i, [&](int stage) {
+    switch (stage) {
+%s    }
+  });
+  stride_pipeline.end(out, nBufferFrames, chunk);
+}
+'''%(len(stages), cases_code)
+        return globals_code, declarations_code, functions_code, run_code
+
+    def parallel_initialization_code(self):
+        # Start the workers here rather than in the first processing call
+        return 'stride_parallel_pool();\n'
+
     def number_to_string(self, number):
         if type(number) == int:
             s = '%i;\n'%number
@@ -440,15 +600,33 @@ public:
         return includes_code
 
     # Handling of rate changes within a stream -------------------------------
+    # A stream at a different rate runs P/Q times for each sample of its parent
+    # rate, where P/Q is the exact ratio between the two rates. Integer
+    # upsampling is a fixed loop. Other ratios step an integer phase counter,
+    # so schedules don't drift over long runs.
+    def rate_ratio(self, rate, parent_rate):
+        # Rates come from decimal literals, so their repr() is exact
+        ratio = Fraction(repr(float(rate))) / Fraction(repr(float(parent_rate)))
+        if ratio.numerator > 0x3FFFFFFF or ratio.denominator > 0x3FFFFFFF:
+            ratio = ratio.limit_denominator(0xFFFFF) # Keep counters within an int
+        return ratio.numerator, ratio.denominator
+
+    def rate_parent(self):
+        if len(self.rate_stack) > 1:
+            return self.rate_stack[-2]
+        else:
+            return self.domain_rate
+
     def rate_init_code(self):
         code = ''
         rate = self.rate_stack[-1]
         index = self.rate_counter
         if not rate == self.domain_rate:
-            if rate < self.domain_rate:
-                code = '_counter_%03i = 1.0;\n'%(index)
-            else:
-                code = '_counter_%03i = 0.0;\n'%(index)
+            P, Q = self.rate_ratio(rate, self.rate_parent())
+            if P < Q:
+                code = '_counter_%03i = %i;\n'%(index, Q - P) # Run on the first parent sample
+            elif Q > 1:
+                code = '_counter_%03i = 0;\n'%(index)
         return code
 
     def rate_instance_code(self):
@@ -456,7 +634,9 @@ public:
         rate = self.rate_stack[-1]
         index = self.rate_counter
         if not rate == self.domain_rate:
-            code = 'float _counter_%03i;\n'%(index)
+            P, Q = self.rate_ratio(rate, self.rate_parent())
+            if Q > 1: # Integer upsampling needs no state
+                code = 'int _counter_%03i;\n'%(index)
         return code
 
     def rate_start(self, rate):
@@ -474,41 +654,59 @@ public:
     def rate_start_code(self):
         code = ''
         rate = self.rate_stack[-1]
-        if len(self.rate_stack) > 1:
-            parent_rate = self.rate_stack[-2]
-        else:
-            parent_rate = self.domain_rate
+        parent_rate = self.rate_parent()
         index = self.rate_counter
         if not rate == parent_rate:
-            if rate < parent_rate:
-                code += self.str_rate_begin_code%(rate, parent_rate)
-                code += 'if (_counter_%03i >= 1.0) {\n_counter_%03i -= 1.0;\n'%(index, index)
+            P, Q = self.rate_ratio(rate, parent_rate)
+            code += self.str_rate_begin_code%(rate, parent_rate)
+            if Q == 1:
+                code += 'for (int _counter_%03i = 0; _counter_%03i < %i; _counter_%03i++) {\n'%(index, index, P, index)
+            elif P < Q:
+                code += '_counter_%03i += %i;\nif (_counter_%03i >= %i) {\n_counter_%03i -= %i;\n'%(index, P, index, Q, index, Q)
             else:
-                code += self.str_rate_begin_code%(rate, parent_rate)
-                code += 'while (_counter_%03i < 1.0) {\n'%(index)
+                code += '_counter_%03i += %i;\nwhile (_counter_%03i >= %i) {\n_counter_%03i -= %i;\n'%(index, P, index, Q, index, Q)
             self.rate_nested += 1
         return code
 
+    def resampler_code(self, rate, in_tokens, quality = 'auto'):
+        ''' Returns instance code, parent rate processing code and new tokens
+        that resample in_tokens for a change from the domain rate to rate.
+        Must be called just before rate_start(). '''
+        if not self.resampling or quality == 'none' or len(self.rate_stack) > 0:
+            return '', '', in_tokens
+        P, Q = self.rate_ratio(rate, self.domain_rate)
+        if P == Q or max(P, Q) > self.resampling_max_factor:
+            return '', '', in_tokens
+        if not quality in self.resampling_presets:
+            quality = 'medium'
+        index = self.rate_counter
+        # Outputs within a parent sample must take ascending phases. The
+        # counter cases count down what is left after each output
+        if Q == 1:
+            phase = '_counter_%03i'%(index)
+        else:
+            phase = '%i - _counter_%03i'%(P - 1, index)
+        inst_code = ''
+        proc_code = ''
+        out_tokens = []
+        for i, token in enumerate(in_tokens):
+            name = '_resampler_%03i_%i'%(index, i)
+            inst_code += 'StrideResampler<%i, %i, %i> %s;\n'%(P, Q, self.resampling_presets[quality], name)
+            proc_code += '%s.push(%s);\n'%(name, token)
+            out_tokens.append('%s.output(%s)'%(name, phase))
+        self.resampling_used = True
+        return inst_code, proc_code, out_tokens
+
     def rate_stack_size(self):
         return len(self.rate_stack)
 
     def rate_end_code(self):
         if len(self.rate_stack) > 0:
             code = ''
+            parent_rate = self.rate_parent()
             rate = self.rate_stack.pop()
-            index = self.rate_counter
-            if len(self.rate_stack) > 1:
-                parent_rate = self.rate_stack[-2]
-            else:
-                parent_rate = self.domain_rate
-            if rate < parent_rate:
-                code += '}\n' # Closes counter check above
-                code += self.str_rate_end_code%rate
-                code += '_counter_%03i += %.10f;\n'%(index, float(rate)/parent_rate)
-            else:
-                code += '_counter_%03i += %.10f;\n'%(index, parent_rate/ float(rate))
+            if not rate == parent_rate:
                 code += '}\n' # Closes counter check above
-                code += '_counter_%03i -= 1.0;\n'%(index)
                 code += self.str_rate_end_code%rate
             self.rate_counter += 1
             return code
@@ -516,7 +714,8 @@ public:
             return ''
 
     # Module code ------------------------------------------------------------
-    def module_declaration(self, name, header_code, init_code, process_code, instance_consts = {}):
+    def module_declaration(self, name, header_code, init_code, process_code, instance_consts = {},
+                           line = -1, filename = '', inline = None):
 
         out_type = 'void'
 
@@ -541,7 +740,11 @@ public:
             if len(input_declaration) > 0:
                 input_declaration = input_declaration[:-2]
 
-            process_functions += self.str_function_declaration%(out_type, 'process_' + str(domain), input_declaration, domain_proc_code)
+            attribute = self.inline_attribute(inline, domain_proc_code)
+            if self.profiling:
+                domain_proc_code = (self.profile_scope_begin(line, filename, name + '::process_' + str(domain))
+                                    + domain_proc_code + self.profile_scope_end())
+            process_functions += self.str_function_declaration%(attribute + out_type, 'process_' + str(domain), input_declaration, domain_proc_code)
 
         for const_name, props in instance_consts.items():
             constructor_args += "float _" + const_name + ","
@@ -24,9 +24,12 @@ class Builder(object):
                 break
 
         # Add python path inside strideroot to module search paths
-        sys.path.append(self.strideroot + "/library/1.0/python")
+        if not self.strideroot + "/library/1.0/python" in sys.path:
+            sys.path.append(self.strideroot + "/library/1.0/python")
         # Add platform scritps path to python module search paths
-        sys.path.append(platform_dir + "/scripts")
+        if not platform_dir + "/scripts" in sys.path:
+            sys.path.append(platform_dir + "/scripts")
+        self.platform_dir = platform_dir
 
         print("Using strideroot:" + strideroot)
         print("Using platform: " + platform_dir)
@@ -47,7 +50,61 @@ class Builder(object):
     def stop(self):
         self.gen.stop()
 
+    def run_command(self):
+        return self.gen.run_command()
+
+# ---------------------
+def worker(strideroot):
+    ''' Serves requests read from stdin, one JSON object per line:
+    {"command": "build" | "run" | "run_command" | "quit",
+     "jsonfile": ..., "products_dir": ..., "debug": false}
+    Modules stay loaded between requests. A worker serves a single platform,
+    as platformGenerator and platformTemplates are imported by name. Each
+    reply is a line starting with "STRIDE_WORKER_DONE " followed by JSON. '''
+    import traceback
+    platform_dir = None
+    working_dir = os.getcwd()
+    while True:
+        line = sys.stdin.readline()
+        if not line:
+            break
+        reply = {'status': 0}
+        try:
+            request = json.loads(line)
+            command = request.get('command', '')
+            if command == 'quit':
+                break
+            builder = Builder(request['jsonfile'], strideroot,
+                              request['products_dir'], request.get('debug', False))
+            if platform_dir and not builder.platform_dir == platform_dir:
+                # The already imported platform modules would be wrong
+                reply = {'status': 2, 'error': 'Worker serves ' + platform_dir}
+            else:
+                platform_dir = builder.platform_dir
+                if command == 'build':
+                    builder.build()
+                elif command == 'run':
+                    builder.run()
+                elif command == 'run_command':
+                    run_command = builder.run_command()
+                    if run_command:
+                        reply['arguments'] = run_command[0]
+                        reply['directory'] = run_command[1]
+                else:
+                    builder.gen.custom_command(command)
+        except Exception:
+            traceback.print_exc()
+            reply = {'status': 1}
+        os.chdir(working_dir) # Generators change directory while building
+        sys.stderr.flush()
+        print("STRIDE_WORKER_DONE " + json.dumps(reply))
+        sys.stdout.flush()
+
 if __name__ == '__main__':
+    if len(sys.argv) > 1 and sys.argv[1] == '--worker':
+        worker(sys.argv[2] if len(sys.argv) > 2 else os.getcwd())
+        sys.exit(0)
+
     import argparse
     cur_path = os.getcwd()
     default_file = '/home/andres/Documents/src/Stride/Stride/strideroot/frameworks/RtAudio/1.0/_tests/module/16_recursive_module_shared.stride'
@@ -0,0 +1,225 @@
+# -*- coding: utf-8 -*-
+"""
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+"""
+
+# Content addressed object cache for generated projects.
+#
+# Objects are keyed on the compiler, its version, the full compile command
+# line, the source and the contents of every header the compiler reports it
+# depends on (-MM). If the compiler can't list dependencies, the headers
+# included with #include "..." are found by scanning the sources instead. The
+# cache directory is shared by all projects on the machine, so objects are
+# reused whenever a source is compiled again with the same command line.
+#
+# The cache lives in ~/.stride/cache unless STRIDE_BUILD_CACHE is set.
+
+from __future__ import print_function
+
+import os
+import re
+import shutil
+import hashlib
+import subprocess
+from multiprocessing.pool import ThreadPool
+
+include_regex = re.compile(r'^\s*#\s*include\s*"([^"]+)"', re.MULTILINE)
+
+def default_cache_dir():
+    if 'STRIDE_BUILD_CACHE' in os.environ:
+        return os.environ['STRIDE_BUILD_CACHE']
+    return os.path.join(os.path.expanduser('~'), '.stride', 'cache')
+
+def file_hash(filename):
+    h = hashlib.sha1()
+    with open(filename, 'rb') as f:
+        for chunk in iter(lambda: f.read(65536), b''):
+            h.update(chunk)
+    return h.hexdigest()
+
+class BuildCache(object):
+    def __init__(self, cache_dir = None, jobs = None, log = print):
+        self.cache_dir = cache_dir if cache_dir else default_cache_dir()
+        self.objects_dir = os.path.join(self.cache_dir, 'objects')
+        if not os.path.isdir(self.objects_dir):
+            try:
+                os.makedirs(self.objects_dir)
+            except OSError: # Created by a concurrent build
+                pass
+        self.jobs = jobs
+        self.log = log
+        self.compiler_versions = {}
+        self.header_hashes = {}
+
+    def compiler_version(self, compiler):
+        if not compiler in self.compiler_versions:
+            try:
+                self.compiler_versions[compiler] = subprocess.check_output([compiler, '--version'])
+            except (OSError, subprocess.CalledProcessError):
+                self.compiler_versions[compiler] = b''
+        return self.compiler_versions[compiler]
+
+    def hash_includes(self, source, include_dirs, h, visited):
+        with open(source, 'rb') as f:
+            text = f.read().decode('utf-8', 'replace')
+        h.update(text.encode('utf-8'))
+        search_dirs = [os.path.dirname(source)] + include_dirs
+        for include in include_regex.findall(text):
+            for directory in search_dirs:
+                header = os.path.normpath(os.path.join(directory, include))
+                if os.path.isfile(header):
+                    if not header in visited:
+                        visited.add(header)
+                        h.update(include.encode('utf-8'))
+                        self.hash_includes(header, include_dirs, h, visited)
+                    break
+
+    def dependencies(self, compiler, flags, source):
+        ''' Returns the headers source depends on, as reported by the
+        compiler, or None if it can't report them. System headers are left
+        out, they are covered by the compiler version. '''
+        try:
+            with open(os.devnull, 'w') as null:
+                output = subprocess.check_output([compiler] + flags + ['-MM', source], stderr = null)
+        except (OSError, subprocess.CalledProcessError):
+            return None
+        rule = output.decode('utf-8', 'replace').replace('\\\n', ' ')
+        rule = rule[rule.find(':') + 1:].replace('\\ ', '\0')
+        files = [name.replace('\0', ' ') for name in rule.split()]
+        return [name for name in files if os.path.abspath(name) != os.path.abspath(source)]
+
+    def object_key(self, compiler, flags, source):
+        h = hashlib.sha1()
+        h.update(compiler.encode('utf-8') + b'\0')
+        h.update(self.compiler_version(compiler))
+        for flag in flags:
+            h.update(flag.encode('utf-8') + b'\0')
+        h.update(source.encode('utf-8') + b'\0')
+        headers = self.dependencies(compiler, flags, source)
+        if headers is None:
+            include_dirs = [flag[2:] for flag in flags if flag.startswith('-I')]
+            self.hash_includes(source, include_dirs, h, set())
+        else:
+            h.update(file_hash(source).encode('utf-8'))
+            for header in headers:
+                h.update(header.encode('utf-8') + b'\0')
+                h.update(file_hash(header).encode('utf-8'))
+        return h.hexdigest()
+
+    def compile(self, compiler, flags, source, object_file):
+        ''' Compiles source into object_file, reusing a cached object when
+        one exists. Returns True if the object was taken from the cache. '''
+        key = self.object_key(compiler, flags, source)
+        cached = os.path.join(self.objects_dir, key[:2], key + '.o')
+        if os.path.isfile(cached):
+            shutil.copyfile(cached, object_file)
+            self.log("Using cached object for " + os.path.basename(source))
+            return True
+
+        args = [compiler] + flags + ['-o' + object_file, '-c', source]
+        self.log(args)
+        outtext = subprocess.check_output(args)
+        self.log(outtext)
+
+        # Store atomically so concurrent builds never see partial objects
+        if not os.path.isdir(os.path.dirname(cached)):
+            try:
+                os.makedirs(os.path.dirname(cached))
+            except OSError:
+                pass
+        temp_file = cached + '.%i.tmp'%os.getpid()
+        shutil.copyfile(object_file, temp_file)
+        os.rename(temp_file, cached)
+        return False
+
+    def compile_all(self, compiler, sources):
+        ''' sources is a list of (flags, source, object_file). Independent
+        compiles run in parallel. Returns the number of cache hits. '''
+        if len(sources) < 2 or self.jobs == 1:
+            results = [self.compile(compiler, flags, source, object_file)
+                       for flags, source, object_file in sources]
+        else:
+            pool = ThreadPool(self.jobs)
+            try:
+                results = pool.map(lambda job: self.compile(compiler, job[0], job[1], job[2]), sources)
+            finally:
+                pool.close()
+                pool.join()
+        return results.count(True)
+
+    def link_key(self, args, object_files):
+        h = hashlib.sha1()
+        for arg in args:
+            h.update(arg.encode('utf-8') + b'\0')
+        for object_file in object_files:
+            h.update(file_hash(object_file).encode('utf-8'))
+        return h.hexdigest()
+
+    def is_linked(self, target, key):
+        ''' True when target was linked with the same arguments from the same
+        objects. The key is stored next to the target by store_link_key(). '''
+        key_file = target + '.linkkey'
+        if os.path.isfile(target) and os.path.isfile(key_file):
+            with open(key_file) as f:
+                return f.read() == key
+        return False
+
+    def store_link_key(self, target, key):
+        with open(target + '.linkkey', 'w') as f:
+            f.write(key)
+
+def tree_signature(directory):
+    entries = []
+    for root, dirs, files in os.walk(directory):
+        dirs.sort()
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            stat = os.stat(path)
+            entries.append('%s %i %i'%(os.path.relpath(path, directory), stat.st_size, int(stat.st_mtime)))
+    return hashlib.sha1('\n'.join(entries).encode('utf-8')).hexdigest()
+
+def sync_tree(source, destination):
+    ''' Copies source to destination unless an unchanged copy is already
+    there. Returns True if the tree was copied. '''
+    signature = tree_signature(source)
+    signature_file = os.path.join(destination, '.stride_tree_signature')
+    if os.path.isfile(signature_file):
+        with open(signature_file) as f:
+            if f.read() == signature:
+                return False
+    if os.path.isdir(destination):
+        shutil.rmtree(destination)
+    shutil.copytree(source, destination)
+    with open(signature_file, 'w') as f:
+        f.write(signature)
+    return True
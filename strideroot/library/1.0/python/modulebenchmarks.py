@@ -0,0 +1,219 @@
+# -*- coding: utf-8 -*-
+"""
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+"""
+
+# Micro-benchmarks for library modules and platform types.
+#
+# Each module (and each platformType in the framework's Math and Trigonometry
+# platform libraries) is wrapped in a minimal program that runs it on the
+# testing domain. The program is built and timed with "stridecc --benchmark"
+# for every combination of block size and width. Width is the number of
+# parallel instances, i.e. what a bundle of that size expands to.
+#
+# Usage:
+#   python modulebenchmarks.py --stridecc path/to/compiler --strideroot path/to/strideroot
+
+from __future__ import print_function
+
+import os
+import re
+import json
+import subprocess
+import argparse
+import tempfile
+
+# Stream for a single instance. {i} is the instance number, {input} a source
+# signal and {output} the instance's output signal.
+library_modules = [
+    ('Oscillator', 'Generators', 'Oscillator(frequency: 440) >> {output};'),
+    ('Impulse', 'Generators', 'Impulse(frequency: 440) >> {output};'),
+    ('BandLimitedSaw', 'Generators', 'BandLimitedSaw(frequency: 440) >> {output};'),
+    ('BiQuad', 'Filters', '{input} >> BiQuad(centerFrequency: 1000 resonance: 0.5) >> {output};'),
+    ('LowPass', 'Filters', '{input} >> LowPass(frequency: 1000) >> {output};'),
+    ('BandPass', 'Filters', '{input} >> BandPass(centerFrequency: 1000) >> {output};'),
+    ('Mix', 'Filters', '[{input}, AudioIn[2]] >> Mix() >> {output};'),
+    ('Rectify', 'Filters', '{input} >> Rectify() >> {output};'),
+    ('Level', None, '{input} >> Level(gain: 0.5) >> {output};'),
+    ('Pan', None, '{input} >> Pan(position: 0.25) >> [{output}, {output}R];'),
+]
+
+def find_platform_types(platformlib_dir, file_names = ['Math.stride', 'Trigonometry.stride']):
+    """ Returns a list of (typeName, number of inputs) for the platform types declared in file_names."""
+    types = []
+    for file_name in file_names:
+        path = os.path.join(platformlib_dir, file_name)
+        if not os.path.exists(path):
+            continue
+        with open(path) as f:
+            text = f.read()
+        for match in re.finditer(r'^platformType\s+\w+\s*\{(.*?)^\}', text, re.MULTILINE | re.DOTALL):
+            body = match.group(1)
+            type_name = re.search(r'typeName\s*:\s*[\'"](\w+)[\'"]', body)
+            inputs = re.search(r'^\s*inputs\s*:\s*\[(.*?)\]', body, re.MULTILINE)
+            if type_name:
+                num_inputs = len([i for i in inputs.group(1).split(',') if i.strip()]) if inputs else 1
+                types.append((type_name.group(1), num_inputs))
+    return types
+
+def make_program(streams, imports):
+    code = 'use DesktopAudio version 1.0\n\n'
+    for imp in sorted(set([i for i in imports if i])):
+        code += 'import %s\n'%imp
+    code += '\n' + '\n'.join(streams) + '\n'
+    return code
+
+def module_program(stream_template, import_name, width):
+    streams = []
+    outputs = []
+    for i in range(1, width + 1):
+        output = 'Out%i'%i
+        streams.append(stream_template.format(i = i, input = 'AudioIn[1]', output = output))
+        outputs.append(output)
+    # Sum the instance outputs so that no instance can be optimized away
+    streams.append(' + '.join(outputs) + ' >> AudioOut[1];')
+    return make_program(streams, [import_name])
+
+def platform_type_program(type_name, num_inputs, width):
+    streams = []
+    outputs = []
+    for i in range(1, width + 1):
+        block = 'Block%i'%i
+        output = 'Out%i'%i
+        streams.append('%s %s {}'%(type_name, block))
+        if num_inputs == 1:
+            source = 'AudioIn[1]'
+        else:
+            source = '[' + ', '.join(['AudioIn[%i]'%(1 + (n % 2)) for n in range(num_inputs)]) + ']'
+        streams.append('%s >> %s >> %s;'%(source, block, output))
+        outputs.append(output)
+    streams.append(' + '.join(outputs) + ' >> AudioOut[1];')
+    return make_program(streams, [])
+
+def empty_program():
+    return make_program(['AudioIn[1] >> AudioOut[1];'], [])
+
+def run_benchmark(stridecc, strideroot, source_file, block_size, extra_config):
+    results_file = source_file + '.%i.json'%block_size
+    args = [stridecc, '--benchmark', '-s', strideroot,
+            '-c', 'BlockSize=%i'%block_size,
+            '--results', results_file]
+    for key, value in extra_config.items():
+        args += ['-c', '%s=%s'%(key, value)]
+    args.append(source_file)
+    try:
+        subprocess.check_output(args, stderr = subprocess.STDOUT)
+    except subprocess.CalledProcessError as e:
+        print('Benchmark failed for %s:\n%s'%(source_file, e.output))
+        return None
+    with open(results_file) as f:
+        results = json.load(f)
+    return results[0] if len(results) > 0 else None
+
+def format_table(rows, block_sizes, widths):
+    header = '| Module |' + ''.join([' %i x%i |'%(b, w) for b in block_sizes for w in widths])
+    separator = '|---|' + '---:|'*(len(block_sizes)*len(widths))
+    lines = ['Cycles/sample per instance (overhead of an empty program subtracted). Columns: block size x width.',
+             '', header, separator]
+    for name, values in rows:
+        line = '| %s |'%name
+        for b in block_sizes:
+            for w in widths:
+                value = values.get((b, w))
+                line += ' %.2f |'%value if value is not None else ' - |'
+        lines.append(line)
+    return '\n'.join(lines) + '\n'
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description = 'Benchmark library modules in isolation.')
+    parser.add_argument('--stridecc', required = True, help = 'Path to the stride command line compiler')
+    parser.add_argument('--strideroot', required = True, help = 'Path to strideroot')
+    parser.add_argument('--framework', default = 'frameworks/RtAudio/1.0', help = 'Framework path within strideroot')
+    parser.add_argument('--block-sizes', default = '64,256,1024')
+    parser.add_argument('--widths', default = '1,4,16')
+    parser.add_argument('--modules', default = '', help = 'Comma separated list of modules/types to run (default all)')
+    parser.add_argument('--work-dir', default = '', help = 'Directory for the generated programs')
+    parser.add_argument('--output', default = 'module_benchmarks.md', help = 'Markdown table to write')
+    parser.add_argument('--json', default = '', help = 'Also write raw results to this JSON file')
+    args = parser.parse_args()
+
+    block_sizes = [int(b) for b in args.block_sizes.split(',')]
+    widths = [int(w) for w in args.widths.split(',')]
+    selected = [m for m in args.modules.split(',') if m]
+    work_dir = args.work_dir if args.work_dir else tempfile.mkdtemp(prefix = 'stride_module_bench_')
+    if not os.path.isdir(work_dir):
+        os.makedirs(work_dir)
+    strideroot = os.path.abspath(args.strideroot)
+
+    programs = []
+    for name, import_name, template in library_modules:
+        programs.append((name, lambda w, t = template, i = import_name: module_program(t, i, w)))
+    platformlib_dir = os.path.join(strideroot, args.framework, 'platformlib')
+    for type_name, num_inputs in find_platform_types(platformlib_dir):
+        programs.append((type_name, lambda w, t = type_name, n = num_inputs: platform_type_program(t, n, w)))
+    if selected:
+        programs = [p for p in programs if p[0] in selected]
+
+    # Overhead of the testing domain itself, per block size
+    empty_file = os.path.join(work_dir, 'Empty.stride')
+    with open(empty_file, 'w') as f:
+        f.write(empty_program())
+    overhead = {}
+    for block_size in block_sizes:
+        result = run_benchmark(args.stridecc, strideroot, empty_file, block_size, {})
+        overhead[block_size] = result['cycles_per_sample'] if result else 0.0
+
+    rows = []
+    raw_results = []
+    for name, make_code in programs:
+        values = {}
+        for width in widths:
+            source_file = os.path.join(work_dir, '%s_%i.stride'%(name, width))
+            with open(source_file, 'w') as f:
+                f.write(make_code(width))
+            for block_size in block_sizes:
+                result = run_benchmark(args.stridecc, strideroot, source_file, block_size, {})
+                if result:
+                    cycles = (result['cycles_per_sample'] - overhead[block_size])/width
+                    values[(block_size, width)] = cycles
+                    result.update({'module': name, 'width': width, 'cycles_per_instance': cycles})
+                    raw_results.append(result)
+                    print('%s block size %i width %i: %.2f cycles/sample'%(name, block_size, width, cycles))
+        rows.append((name, values))
+
+    with open(args.output, 'w') as f:
+        f.write(format_table(rows, block_sizes, widths))
+    print('Wrote ' + args.output)
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump(raw_results, f, indent = 2)
@@ -1218,7 +1218,9 @@ class ModuleAtom(Atom):
         declaration_text = templates.module_declaration(
                 self.name, header_code,
                 init_code, process_code,
-                self.instance_consts)
+                self.instance_consts,
+                self.module.get('line', -1), self.module.get('filename', ''),
+                self.module.get('inline', None))
 
         self.code_declaration = Declaration(self.module['stack_index'],
                                         self.domain,
@@ -2140,6 +2142,10 @@ class PlatformFunctions:
         self.scope_stack = []
         self.parent_stack = []
 
+        # Shared by all generate_code() calls for this tree
+        self.global_groups = {'include':[], 'includeDir':[], 'initializations' : [], 'linkTo' : [], 'linkDir' : []}
+        self.instanced = []
+
         self.sample_rate = 44100 # Set this as default but this should be overriden by platform:
 
         decl = self.find_declaration_in_tree('PlatformRate')
@@ -2148,6 +2154,7 @@ class PlatformFunctions:
             self.sample_rate = decl['value']
         templates.domain_rate = self.sample_rate
         self.unique_id = 0
+        self.module_side_effects = {}
 
     def log_debug(self, text):
         if self.debug_messages:
@@ -2561,6 +2568,15 @@ class PlatformFunctions:
                         current_rate = atom.rate
                     elif atom.rate != current_rate:
                         templates.set_domain_rate(self.get_domain_default_rate(current_domain))
+                        if type(atom) == NameAtom and atom.declaration['type'] == 'signal':
+                            quality = atom.declaration.get('resampling', 'auto')
+                            if quality is None: # resampling: none
+                                quality = 'none'
+                            elif type(quality) != str and type(quality) != unicode:
+                                quality = 'auto'
+                            resampler_inst, resampler_proc, in_tokens = templates.resampler_code(atom.rate, in_tokens, quality)
+                            processing_code[current_domain] += resampler_proc
+                            header_code[current_domain] += resampler_inst
                         new_inst, new_init, new_proc = templates.rate_start(atom.rate)
                         processing_code[current_domain] += new_proc
                         header_code[current_domain] += new_inst
@@ -2693,6 +2709,9 @@ class PlatformFunctions:
         for domain in new_processing_code.keys():
             wrapper_begin = templates.stream_begin_code%stream_index + templates.source_marker(first_line, stream_filename)
             wrapper_end =  templates.stream_end_code%stream_index
+            if templates.profiling:
+                wrapper_begin += templates.profile_scope_begin(first_line, stream_filename, 'stream %i'%stream_index)
+                wrapper_end = templates.profile_scope_end() + wrapper_end
             new_processing_code[domain] = wrapper_begin + new_processing_code[domain] + wrapper_end
 
         return {"global_groups" : global_groups,
@@ -2816,32 +2835,332 @@ class PlatformFunctions:
 
         return platform_dir
 
-    def visit_element(self, element, marked, temp_marked, sorted_list, elements):
-        if element in temp_marked:
-            print("ERROR! not a DAG.")
-            return
-        if not element in marked:
-            temp_marked.append(element)
-            for e in elements:
-                if e is not element and element in e.get_dependents():
-                    self.visit_element(e, marked, temp_marked, sorted_list, elements)
-            marked.append(element)
-            temp_marked.remove(element)
-            sorted_list.insert(0, element)
-
     def sort_elements(self, elements):
+        # Depth first topological sort https://en.wikipedia.org/wiki/Topological_sorting
+        # An element must come after all the elements that list it as a
+        # dependent. The predecessor map is built once, in element order, so the
+        # result is the same as visiting every element for every node.
+        predecessors = {}
+        for e in elements:
+            for dep in e.get_dependents():
+                if dep is e:
+                    continue
+                dep_predecessors = predecessors.setdefault(dep, [])
+                if not dep_predecessors or dep_predecessors[-1] is not e:
+                    dep_predecessors.append(e)
+
         sorted_list = []
-        marked = []
-        temp_marked = []
-#        L ← Empty list that will contain the sorted nodes
+        marked = set()
+        temp_marked = set()
         for element in elements:
-            if not element in marked:
-                self.visit_element(element, marked, temp_marked, sorted_list, elements)
-        return sorted_list[::-1]
+            if element in marked:
+                continue
+            temp_marked.add(element)
+            stack = [(element, iter(predecessors.get(element, [])))]
+            while stack:
+                current, pending = stack[-1]
+                for e in pending:
+                    if e in temp_marked:
+                        print("ERROR! not a DAG.")
+                    elif not e in marked:
+                        temp_marked.add(e)
+                        stack.append((e, iter(predecessors.get(e, []))))
+                        break
+                else:
+                    stack.pop()
+                    temp_marked.discard(current)
+                    marked.add(current)
+                    sorted_list.append(current)
+        return sorted_list
+
+    # Parallel execution ------------------------------------------------------
+    SIDE_EFFECTS = ('', None) # Shared by all streams with side effects
+
+    def make_stream_clusters(self, streams, num_clusters):
+        ''' Groups the (code, stream) pairs of a domain into at most
+        num_clusters blocks of processing code that can run concurrently.
+        Streams that access a common signal and one of them writes it are
+        kept together in their original order. So are all streams with side
+        effects. Groups are balanced by their processing cost. '''
+        accesses = [self.stream_accesses(stream) for code, stream in streams]
+        parents = list(range(len(streams)))
+
+        def find(i):
+            while parents[i] != i:
+                parents[i] = parents[parents[i]]
+                i = parents[i]
+            return i
+
+        for i in range(len(streams)):
+            for j in range(i):
+                if find(i) != find(j) and self._accesses_conflict(accesses[i], accesses[j]):
+                    parents[find(i)] = find(j)
+
+        groups = {}
+        for i in range(len(streams)):
+            groups.setdefault(find(i), []).append(i)
+        costs = [1 + templates.processing_cost(code) for code, stream in streams]
+        groups = sorted(groups.values(), key=lambda group: -sum(costs[i] for i in group))
+
+        # Largest first, each into the least loaded cluster
+        clusters = [[] for i in range(min(num_clusters, len(groups)))]
+        loads = [0 for cluster in clusters]
+        for group in groups:
+            target = loads.index(min(loads))
+            clusters[target] += group
+            loads[target] += sum(costs[i] for i in group)
+
+        return ['\n'.join([streams[i][0] for i in sorted(cluster)]) for cluster in clusters]
+
+    def make_pipeline_stages(self, streams, num_stages):
+        ''' Splits the (code, stream) pairs of a domain into at most num_stages
+        consecutive stages with balanced processing cost. Returns a list of
+        (code, loads, stores), see BaseCTemplate.pipeline_code(). Stages can
+        only be cut where no later stream writes what an earlier one uses,
+        so feedback stays within a stage, and where the signals passed on
+        are single values. '''
+        n = len(streams)
+        accesses = []
+        for code, stream in streams:
+            reads, writes = self.stream_accesses(stream)
+            # Hardware channels are kept per block by the pipeline
+            accesses.append((set([key for key in reads if not self._is_block_io(key)]),
+                             set([key for key in writes if not self._is_block_io(key)])))
+        costs = [1 + templates.processing_cost(code) for code, stream in streams]
+
+        def passed(first, last, begin, end):
+            ''' Signals written in streams [first, last) and read in [begin, end) '''
+            written = set()
+            for reads, writes in accesses[first:last]:
+                written |= writes
+            keys = set()
+            for reads, writes in accesses[begin:end]:
+                for key in reads:
+                    if any([self._keys_overlap(key, other) for other in written]):
+                        keys.add(key)
+            return keys
+
+        cuts = [0]
+        for i in range(1, n):
+            before = (set(), set())
+            after = (set(), set())
+            for reads, writes in accesses[:i]:
+                before[0].update(reads)
+                before[1].update(writes)
+            for reads, writes in accesses[i:]:
+                after[0].update(reads)
+                after[1].update(writes)
+            if self._accesses_conflict((set(), after[1]), (before[0], before[1])):
+                continue
+            if all([self._passed_type(key) for key in passed(0, i, i, n)]):
+                cuts.append(i)
+        cuts.append(n)
+
+        # best[k][c]: lowest cost of the slowest stage for the streams before
+        # cuts[c] in k + 1 stages
+        prefix = [0]
+        for cost in costs:
+            prefix.append(prefix[-1] + cost)
+        best = [[(prefix[cut], None) for cut in cuts]]
+        for k in range(1, min(num_stages, len(cuts) - 1)):
+            row = [(None, None)]
+            for c in range(1, len(cuts)):
+                candidates = [(max(best[k - 1][b][0], prefix[cuts[c]] - prefix[cuts[b]]), b)
+                              for b in range(1, c) if best[k - 1][b][0] is not None]
+                row.append(min(candidates) if candidates else (None, None))
+            best.append(row)
+        stages_count = min(range(len(best)), key=lambda k: (best[k][-1][0] is None, best[k][-1][0], k))
+
+        bounds = [n]
+        c = len(cuts) - 1
+        for k in range(stages_count, 0, -1):
+            c = best[k][c][1]
+            bounds.insert(0, cuts[c])
+        bounds.insert(0, 0)
+
+        stages = []
+        for s in range(len(bounds) - 1):
+            begin, end = bounds[s], bounds[s + 1]
+            loads = sorted([(key[0], self._passed_type(key)) for key in passed(0, begin, begin, end)])
+            stores = sorted([(key[0], self._passed_type(key)) for key in passed(begin, end, end, n)])
+            code = '\n'.join([streams[i][0] for i in range(begin, end)])
+            stages.append((code, loads, stores))
+        return stages
+
+    def _passed_type(self, key):
+        # Type used to pass a signal between pipeline stages, if possible
+        declaration = self.find_declaration_in_tree(key[0])
+        if key[1] is not None or not declaration or 'size' in declaration:
+            return None
+        if declaration['type'] == 'signal' and not signal_type_string(declaration):
+            return templates.real_type
+        if declaration['type'] in ['switch', 'trigger']:
+            return templates.bool_type
+        return None
+
+    def _is_block_io(self, key):
+        if key == self.SIDE_EFFECTS:
+            return False
+        declaration = self.find_declaration_in_tree(key[0])
+        return bool(declaration) and not declaration['type'] in ['signal', 'switch', 'trigger', 'signalbridge']
+
+    def stream_accesses(self, stream):
+        ''' Returns the sets of (name, bundle index) read and written by a
+        stream. An index of None stands for the whole bundle. '''
+        reads = set()
+        writes = set()
+        if stream is None:
+            writes.add(self.SIDE_EFFECTS)
+            return reads, writes
+        for i, member in enumerate(stream):
+            self._member_accesses(member, i < len(stream) - 1, i > 0, reads, writes)
+        return reads, writes
+
+    def _member_accesses(self, member, read, write, reads, writes):
+        if 'name' in member or 'bundle' in member:
+            node = member['name'] if 'name' in member else member['bundle']
+            index = None
+            if 'bundle' in member:
+                if type(node['index']) == int:
+                    index = node['index']
+                else:
+                    self._member_accesses({'name': {'name': node['index']}}, True, False, reads, writes)
+            kind = self._block_kind(self.find_declaration_in_tree(node['name']))
+            if kind == 'storage':
+                if read:
+                    reads.add((node['name'], index))
+                if write:
+                    writes.add((node['name'], index))
+            elif kind == 'side_effects':
+                writes.add(self.SIDE_EFFECTS)
+        elif 'function' in member:
+            function = member['function']
+            declaration = self.find_declaration_in_tree(function['name'])
+            for port_name, value in function['ports'].items():
+                if port_name in ['domain', 'rate', 'reset'] or type(value) != dict:
+                    continue
+                self._member_accesses(value, True, self._is_output_port(declaration, port_name), reads, writes)
+            if self._block_kind(declaration) == 'side_effects':
+                writes.add(self.SIDE_EFFECTS)
+        elif 'expression' in member:
+            for operand in ['value', 'left', 'right']:
+                if operand in member['expression']:
+                    self._member_accesses(member['expression'][operand], read, False, reads, writes)
+        elif 'list' in member:
+            for element in member['list']:
+                self._member_accesses(element, read, write, reads, writes)
+        elif 'portproperty' in member:
+            writes.add(self.SIDE_EFFECTS)
+
+    def _is_output_port(self, declaration, port_name):
+        # Output properties write to the signal they name. Unknown ports might
+        if not declaration or declaration.get('type') != 'module' or not declaration.get('ports'):
+            return True
+        for port in declaration['ports']:
+            port_block = port.get('block', port.get('blockbundle'))
+            if port_block and port_block.get('name') == port_name:
+                return not 'Input' in port_block['type']
+        return True
+
+    def _accesses_conflict(self, first, second):
+        for written, other in [(first[1], second), (second[1], first)]:
+            for key in written:
+                for other_key in other[0] | other[1]:
+                    if self._keys_overlap(key, other_key):
+                        return True
+        return False
+
+    def _keys_overlap(self, key, other_key):
+        return key[0] == other_key[0] and (key[1] is None or other_key[1] is None or key[1] == other_key[1])
+
+    def _block_kind(self, declaration, module_blocks = None):
+        ''' Returns 'storage' for values shared between streams, 'side_effects'
+        for blocks whose code can't safely run concurrently with others and
+        'none' for anything else. Module instances belong to a single stream. '''
+        if not declaration or not 'type' in declaration:
+            return 'side_effects'
+        block_type = declaration['type']
+        if block_type in ['signal', 'switch', 'trigger', 'signalbridge']:
+            return 'storage'
+        if block_type == 'module':
+            return 'side_effects' if self._module_has_side_effects(declaration) else 'none'
+        if block_type in ['reaction', 'loop']:
+            return 'side_effects'
+        platform_type = self.find_stride_type(block_type)
+        if platform_type and platform_type['block']['type'] == 'platformType':
+            platform_block = platform_type['block']
+            # Every platformType has a pure property, empty unless set
+            if platform_block.get('pure') or (platform_block.get('outputs')
+                                            and not platform_block.get('declarations')
+                                            and not platform_block.get('initializations')):
+                return 'none'
+            # Hardware channels are bundles written like signals
+            if 'size' in declaration and module_blocks is None:
+                return 'storage'
+            return 'side_effects'
+        if platform_type and platform_type['block']['type'] == 'platformModule':
+            return 'side_effects'
+        return 'none' # constants, domains...
+
+    def _module_has_side_effects(self, module, depth = 0):
+        name = module['name']
+        if name in self.module_side_effects:
+            return self.module_side_effects[name]
+        if depth > 16: # Recursion guard
+            return True
+        self.module_side_effects[name] = True # Until proven otherwise
+        side_effects = False
+        local_names = set()
+        for node in module.get('blocks', []):
+            block = node.get('block', node.get('blockbundle'))
+            if not block:
+                continue
+            local_names.add(block['name'])
+            kind = self._block_kind(block, module.get('blocks', []))
+            if kind == 'side_effects':
+                side_effects = True
+
+        # Names not declared in the module reach outside of it
+        def check(member):
+            if 'name' in member or 'bundle' in member:
+                node = member['name'] if 'name' in member else member['bundle']
+                if not node['name'] in local_names:
+                    return self._block_kind(self.find_declaration_in_tree(node['name'])) != 'none'
+            elif 'function' in member:
+                function = member['function']
+                for port_name, value in function['ports'].items():
+                    if type(value) == dict and not port_name in ['domain', 'rate', 'reset'] and check(value):
+                        return True
+                if not function['name'] in local_names:
+                    declaration = self.find_declaration_in_tree(function['name'])
+                    if declaration and declaration.get('type') == 'module':
+                        return self._module_has_side_effects(declaration, depth + 1)
+                    return self._block_kind(declaration) != 'none'
+            elif 'expression' in member:
+                return any([check(member['expression'][operand]) for operand in ['value', 'left', 'right']
+                            if operand in member['expression']])
+            elif 'list' in member:
+                return any([check(element) for element in member['list']])
+            elif 'portproperty' in member:
+                return False
+            return False
+
+        for node in module.get('streams', []):
+            if side_effects:
+                break
+            if 'stream' in node:
+                side_effects = any([check(member) for member in node['stream']])
+
+        self.module_side_effects[name] = side_effects
+        return side_effects
 
     def generate_code(self, tree, current_scope = [],
-                      global_groups = {'include':[], 'includeDir':[], 'initializations' : [], 'linkTo' : [], 'linkDir' : []},
-                      instanced = [], parent = None, defer_header = False):
+                      global_groups = None,
+                      instanced = None, parent = None, defer_header = False):
+        if global_groups is None:
+            global_groups = self.global_groups
+        if instanced is None:
+            instanced = self.instanced
         stream_index = 0
 
         self.log_debug("* New Generation ----- scopes: " + str(len(self.scope_stack)))
@@ -2897,6 +3216,7 @@ class PlatformFunctions:
                         "init_code" : '',
                         "processing_code" : [] }
                     domain_code[domain]["processing_code"].append(processing_code)
+                    domain_code[domain].setdefault("streams", []).append(node["stream"])
 
                 scope_declarations += code["scope_declarations"]
                 scope_instances += code["scope_instances"]
@@ -2919,16 +3239,11 @@ class PlatformFunctions:
 
         # Remove duplicate elements while keeping dependencies
         clean_list = []
+        declared = {}
         for new_element in header_elements:
-            is_declared = False
-            matched_declaration = None
-            for d in clean_list:
-                # FIXME we need to check scope here to... It's tricky because of the hacks in module, reaction and loop to bring the declarations to the right scope
-                if d.get_name() == new_element.get_name(): # and d.get_scope() == new_element.get_scope():
-                    is_declared = True
-                    matched_declaration = d
-                    break
-            if not is_declared:
+            # FIXME we need to check scope here to... It's tricky because of the hacks in module, reaction and loop to bring the declarations to the right scope
+            matched_declaration = declared.get(new_element.get_name()) # and d.get_scope() == new_element.get_scope():
+            if matched_declaration is None:
                 # FIXME This assigns the platform domain when domain is not specified
                 # The right way is to know which domains it is required in.
                 # e.g. a module declaration might need to be put in various
@@ -2940,13 +3255,15 @@ class PlatformFunctions:
                 if not new_element_domain:
                     new_element.domain = self.get_platform_domain()
                 clean_list.append(new_element)
+                declared[new_element.get_name()] = new_element
             else:
+                known_dependents = set(matched_declaration.get_dependents())
                 for dep in new_element.get_dependents():
-                    if not dep in matched_declaration.get_dependents():
+                    if not dep in known_dependents:
                         matched_declaration.add_dependent(dep)
+                        known_dependents.add(dep)
  #               self.log_debug("Element already queued: " + new_element.get_name())
 
-        # Topological sort https://en.wikipedia.org/wiki/Topological_sorting
         sorted_elements = self.sort_elements(clean_list)
 
         # Generate code from elements
@@ -2997,6 +3314,7 @@ from subprocess import check_output as ck_out
 import platform
 import os
 import json
+from collections import OrderedDict
 
 class GeneratorBase(object):
     def __init__(self, out_dir = '',
@@ -3016,6 +3334,9 @@ class GeneratorBase(object):
         else:
             self.config = {}
 
+        # The templates object is shared by all modules. Clear state left by
+        # a previous build in the same process (see build.py --worker)
+        templates.reset()
         self.templates = templates
         self.platform = PlatformFunctions(self.tree, debug)
 
@@ -3026,38 +3347,67 @@ class GeneratorBase(object):
     def log(self, text):
         print(text)
 
-    def write_section_in_file(self, sec_name, code, filename):
-        f = open(filename, 'r')
-        text = f.read()
-        f.close()
-    #    log(text)
+    def find_section(self, text, sec_name):
         start_index = text.find("//[[%s]]"%sec_name)
         end_index = text.find("//[[/%s]]"%sec_name, start_index)
         if start_index <0 or end_index < 0:
             raise ValueError("Error finding [[%s]]  section"%sec_name)
-            return
-        if sec_name in self.written_sections:
-            code = text[start_index + len("//[[%s]]"%sec_name):end_index] + code
+        return start_index, end_index
+
+    def add_section_code(self, sections, sec_name, code):
+        # Sections are filled in memory and written by write_sections_to_file()
+        if sec_name in sections:
+            sections[sec_name] += code
         else:
-            self.written_sections.append(sec_name)
-        text = text[:start_index] + '//[[%s]]\n'%sec_name + code + text[end_index:]
+            sections[sec_name] = code
+
+    def write_sections_to_file(self, sections, filename):
+        f = open(filename, 'r')
+        text = f.read()
+        f.close()
+        # Splice sections from the end of the file so indices stay valid
+        spans = []
+        for sec_name in sections:
+            start_index, end_index = self.find_section(text, sec_name)
+            spans.append((start_index, end_index, sec_name))
+        for start_index, end_index, sec_name in sorted(spans, reverse=True):
+            code = sections[sec_name]
+            if sec_name in self.written_sections:
+                code = text[start_index + len("//[[%s]]"%sec_name):end_index] + code
+            else:
+                self.written_sections.append(sec_name)
+                code = '\n' + code
+            text = text[:start_index] + '//[[%s]]'%sec_name + code + text[end_index:]
         f = open(filename, 'w')
         f.write(text)
         f.close()
 
+    def write_section_in_file(self, sec_name, code, filename):
+        self.write_sections_to_file({sec_name: code}, filename)
+
     def write_code(self, code, filename):
+        # All sections are assembled in memory and the file is written once
+        file_sections = OrderedDict()
         # First write globals to the platform default domain
         domains = self.platform.get_domains()
         globals_code = templates.get_globals_code(code['global_groups'])
+        if templates.profiling:
+            globals_code = '#include "stride_profiler.hpp"\n' + globals_code
+        if templates.resampling_used:
+            globals_code = '#include "stride_resampler.hpp"\n' + globals_code
+        if templates.inline_used:
+            globals_code = templates.inline_macros_code() + globals_code
         for platform_domain in domains:
             if platform_domain['domainName'] == self.platform.get_platform_domain(): # Platform domain found
                 break
-        self.write_section_in_file(platform_domain['globalsTag'], globals_code, filename)
+        self.add_section_code(file_sections, platform_domain['globalsTag'], globals_code)
+        main_domain = platform_domain
 
         template_init_code = templates.get_config_code()
         config_code = templates.get_configuration_code(code['global_groups']['initializations'])
-        self.write_section_in_file(platform_domain['initializationTag'], template_init_code + config_code, filename)
+        self.add_section_code(file_sections, platform_domain['initializationTag'], template_init_code + config_code)
         processing_code = {}
+        processing_streams = {} # (code, stream) pairs to group for parallel execution
 
         # Write generated code
         for domain,sections in code['domain_code'].items():
@@ -3074,11 +3424,15 @@ class GeneratorBase(object):
                     if not domain in processing_code:
                         processing_code[domain] = ""
                     processing_code[domain] += '\n'.join(sections['processing_code'])
+                    if not domain in processing_streams:
+                        processing_streams[domain] = []
+                    streams = sections.get('streams', [None for c in sections['processing_code']])
+                    processing_streams[domain] += list(zip(sections['processing_code'], streams))
 
-                    self.write_section_in_file(platform_domain['declarationsTag'], sections['header_code'], filename)
-                    self.write_section_in_file(platform_domain['initializationTag'], sections['init_code'], filename)
+                    self.add_section_code(file_sections, platform_domain['declarationsTag'], sections['header_code'])
+                    self.add_section_code(file_sections, platform_domain['initializationTag'], sections['init_code'])
                     if 'cleanup_code' in sections:
-                        self.write_section_in_file(platform_domain['cleanupTag'], sections['cleanup_code'], filename)
+                        self.add_section_code(file_sections, platform_domain['cleanupTag'], sections['cleanup_code'])
                     domain_matched = True
                     break
             if not domain_matched:
@@ -3090,27 +3444,76 @@ class GeneratorBase(object):
                 if platform_domain['domainName'] == domain: # Check if domain is used in code (perhaps this should be cleanup by by the code resolver instread of having to check here?)
                     if platform_domain['domainIncludes']:
                         inc_text = templates.get_includes_code(platform_domain['domainIncludes'])
-                        self.write_section_in_file(platform_domain['declarationsTag'], inc_text, filename)
+                        self.add_section_code(file_sections, platform_domain['declarationsTag'], inc_text)
                     if platform_domain['domainDeclarations']:
                         for declaration in platform_domain['domainDeclarations']:
-                            self.write_section_in_file(platform_domain['declarationsTag'], templates.process_code(declaration['value']) + '\n', filename)
+                            self.add_section_code(file_sections, platform_domain['declarationsTag'], templates.process_code(declaration['value']) + '\n')
                     if platform_domain['domainInitialization']:
-                        self.write_section_in_file(platform_domain['initializationTag'], templates.process_code(platform_domain['domainInitialization']) + '\n', filename)
+                        self.add_section_code(file_sections, platform_domain['initializationTag'], templates.process_code(platform_domain['domainInitialization']) + '\n')
                     if platform_domain['domainCleanup']:
-                        self.write_section_in_file(platform_domain['cleanupTag'], templates.process_code(platform_domain['domainCleanup']) + '\n', filename)
+                        self.add_section_code(file_sections, platform_domain['cleanupTag'], templates.process_code(platform_domain['domainCleanup']) + '\n')
 
         # Now join processing code from code generation with processing function from domain declaration
         for domain in processing_code:
             for platform_domain in domains:
                 if platform_domain['domainName'] == domain:
                     code = processing_code[domain]
+                    block_code = ''
+                    if (templates.pipeline_stages > 1 and platform_domain['domainFunction']
+                            and platform_domain.get('domainClusterFunction', '')):
+                        stages = self.platform.make_pipeline_stages(processing_streams[domain],
+                                                                    templates.pipeline_stages)
+                        self.platform.log_debug("%i pipeline stages in %s"%(len(stages), domain))
+                        if len(stages) > 1:
+                            pipeline_globals, pipeline_declarations, stage_code, block_code = templates.pipeline_code(
+                                domain, stages,
+                                platform_domain['domainClusterFunction'],
+                                platform_domain['domainClusterCall'])
+                            self.add_section_code(file_sections, main_domain['globalsTag'], pipeline_globals)
+                            self.add_section_code(file_sections, platform_domain['declarationsTag'], pipeline_declarations)
+                            self.add_section_code(file_sections, platform_domain['processingTag'], stage_code)
+                            code = ''
+                    elif (templates.parallel_threads > 0 and platform_domain['domainFunction']
+                            and platform_domain.get('domainClusterFunction', '')):
+                        clusters = self.platform.make_stream_clusters(processing_streams[domain],
+                                                                      templates.parallel_threads + 1)
+                        self.platform.log_debug("%i parallel clusters in %s"%(len(clusters), domain))
+                        if len(clusters) > 1:
+                            cluster_code, block_code = templates.parallel_code(domain, clusters,
+                                                                               platform_domain['domainClusterFunction'],
+                                                                               platform_domain['domainClusterCall'])
+                            self.add_section_code(file_sections, platform_domain['processingTag'], cluster_code)
+                            code = ''
+                    if templates.profiling: # Domain totals are registered with line -1
+                        code = templates.profile_scope_begin(-1, domain, domain) + code + templates.profile_scope_end()
                     if not platform_domain['domainFunction'] == '':
-                        code = platform_domain['domainFunction'].replace("%%domainCode%%", code)
+                        code = platform_domain['domainFunction'].replace("%%domainCode%%", code).replace("%%domainBlockCode%%", block_code)
 
-                    self.write_section_in_file(platform_domain['processingTag'], code, filename)
+                    self.add_section_code(file_sections, platform_domain['processingTag'], code)
+
+        if templates.parallel_used:
+            self.add_section_code(file_sections, main_domain['globalsTag'], '#include "stride_parallel.hpp"\n')
+            # Before the domain initialization, which starts processing
+            init_tag = main_domain['initializationTag']
+            file_sections[init_tag] = templates.parallel_initialization_code() + file_sections.get(init_tag, '')
+
+        # Profiling sites are only known once all code has been generated
+        if templates.profiling:
+            for platform_domain in domains:
+                if platform_domain['domainName'] == self.platform.get_platform_domain():
+                    self.add_section_code(file_sections, platform_domain['declarationsTag'], templates.profile_declarations_code())
+                    # Before the domain initialization, which blocks until the program quits
+                    init_tag = platform_domain['initializationTag']
+                    file_sections[init_tag] = templates.profile_initialization_code() + file_sections.get(init_tag, '')
+                    break
+
+        self.write_sections_to_file(file_sections, filename)
 
 
     def make_code_pretty(self):
+        # astyle is only run when requested, as it rewrites the whole file
+        if not self.config.get('PrettyPrint', False):
+            return
         if platform.system() == "Linux":
             try:
                 self.log("Running astyle...")
@@ -3129,6 +3532,11 @@ class GeneratorBase(object):
     def run(self):
         pass
 
+    def run_command(self):
+        ''' Returns (arguments, working directory) to run the built program
+        directly, or None if it must be run through run() '''
+        return None
+
     def stop(self):
         pass
 
@@ -70,7 +70,8 @@ bool BuildTester::test(std::string filename, std::string expectedResultFile)
      }
 
      if (tree) {
-         CodeValidator validator(QString::fromStdString(m_StrideRoot), tree, CodeValidator::USE_TESTING);
+         CodeValidator validator(QString::fromStdString(m_StrideRoot), tree,
+                                 CodeValidator::Options(CodeValidator::USE_TESTING | CodeValidator::OPTIMIZE));
          errors << validator.getErrors();
 
          if (errors.size() > 0) {
@@ -105,40 +106,9 @@ bool BuildTester::test(std::string filename, std::string expectedResultFile)
              for (auto builder: m_builders) {
                  builder->clearBuffers();
                  buildOK &= builder->run();
-                 QFile expectedResult(QString::fromStdString(expectedResultFile));
-                 QStringList outputLines = builder->getStdOut().split("\n");
-                 if (!expectedResult.open(QIODevice::ReadOnly | QIODevice::Text)) {
+                 if (!compareOutput(builder->getStdOut(), expectedResultFile)) {
                      return false;
                  }
-                 for(int i = 0; i < 7; i++) {
-                     outputLines.pop_front(); // Hack to remove initial text
-                 }
-                 if (outputLines.size() <  10) {
-                     return false; // too few lines
-                 }
-
-                 int counter = 0;
-                 while (!expectedResult.atEnd() && !(counter >= outputLines.size())) {
-                     QByteArray line = expectedResult.readLine();
-                     if (line.endsWith("\n")) {
-                         line.chop(1);
-                     }
-                     if (line.size() > 0 && outputLines.at(counter).size() > 0) {
-                         double expected = line.toDouble();
-                         double out = outputLines.at(counter).toDouble();
-                         if (!(std::fabs(out - expected) < 0.000002)) {
-                             std::cerr << "Failed comparison at line " << counter + 1 << std::endl;
-                             std::cerr << "Got " << outputLines.at(counter).toStdString() << " Expected " << line.toStdString() << std::endl;
-                             QFile failedOutput("failed.output");
-                             if (failedOutput.open(QIODevice::WriteOnly)) {
-                                 failedOutput.write(builder->getStdOut().toLocal8Bit());
-                                 failedOutput.close();
-                             }
-                             return false;
-                         }
-                     }
-                     counter++;
-                 }
 //                 std::cout << builder->getStdOut().toStdString() << std::endl;
              }
          }
@@ -153,3 +123,57 @@ bool BuildTester::test(std::string filename, std::string expectedResultFile)
      }
      return buildOK;
 }
+
+bool BuildTester::compareOutput(QString output, std::string expectedResultFile,
+                                QString failedOutputFile, QString *message)
+{
+    QFile expectedResult(QString::fromStdString(expectedResultFile));
+    QStringList outputLines = output.split("\n");
+    if (!expectedResult.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        if (message) {
+            *message = "Can't open " + expectedResult.fileName();
+        }
+        return false;
+    }
+    // Remove the text printed by build.py when the program is run through it
+    for (int i = 0; i < outputLines.size(); i++) {
+        if (outputLines.at(i).startsWith("Running in directory:")) {
+            outputLines = outputLines.mid(i + 1);
+            break;
+        }
+    }
+    if (outputLines.size() <  10) {
+        if (message) {
+            *message = "Too few lines in output";
+        }
+        return false; // too few lines
+    }
+
+    int counter = 0;
+    while (!expectedResult.atEnd() && !(counter >= outputLines.size())) {
+        QByteArray line = expectedResult.readLine();
+        if (line.endsWith("\n")) {
+            line.chop(1);
+        }
+        if (line.size() > 0 && outputLines.at(counter).size() > 0) {
+            double expected = line.toDouble();
+            double out = outputLines.at(counter).toDouble();
+            if (!(std::fabs(out - expected) < 0.000002)) {
+                QString text = QString("Failed comparison at line %1. Got %2 Expected %3")
+                        .arg(counter + 1).arg(outputLines.at(counter)).arg(QString(line));
+                std::cerr << text.toStdString() << std::endl;
+                if (message) {
+                    *message = text;
+                }
+                QFile failedOutput(failedOutputFile);
+                if (failedOutput.open(QIODevice::WriteOnly)) {
+                    failedOutput.write(output.toLocal8Bit());
+                    failedOutput.close();
+                }
+                return false;
+            }
+        }
+        counter++;
+    }
+    return true;
+}
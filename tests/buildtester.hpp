@@ -37,13 +37,20 @@
 
 #include <string>
 
+#include <QString>
 
 class BuildTester
 {
 public:
     BuildTester(std::string strideRoot = "/home/andres/Documents/src/Stride/Stride/strideroot");
     bool test(std::string filename, std::string expectedResultFile);
-    
+
+    /// Compare the output of a testing build against the values in expectedResultFile.
+    /// On mismatch the full output is written to failedOutputFile.
+    static bool compareOutput(QString output, std::string expectedResultFile,
+                              QString failedOutputFile = "failed.output",
+                              QString *message = nullptr);
+
 private:
     std::string m_StrideRoot;
 };
@@ -0,0 +1,345 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#include <iostream>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QXmlStreamWriter>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "codevalidator.h"
+#include "buildtester.hpp"
+
+#include "paralleltester.hpp"
+
+class ParallelTestTask : public QRunnable
+{
+public:
+    ParallelTestTask(ParallelTester *tester, size_t index, ParallelTester::PreparedTest prepared) :
+        m_tester(tester), m_index(index), m_prepared(prepared) {}
+
+    void run() override {
+        m_tester->buildAndRun(m_index, m_prepared);
+    }
+
+private:
+    ParallelTester *m_tester;
+    size_t m_index;
+    ParallelTester::PreparedTest m_prepared;
+};
+
+ParallelTester::ParallelTester(std::string strideRoot, QString productsRoot,
+                               int maxJobs, int timeoutMs) :
+    m_strideRoot(strideRoot), m_productsRoot(productsRoot),
+    m_maxJobs(maxJobs), m_timeout(timeoutMs),
+    m_systems(QString::fromStdString(strideRoot)), m_totalElapsed(0)
+{
+    if (m_productsRoot.isEmpty()) {
+        m_productsRoot = QDir::tempPath() + QDir::separator() + "StrideTestProducts";
+    }
+}
+
+void ParallelTester::addTest(QString filename, QString expectedFile, QString suite)
+{
+    QFileInfo info(filename);
+    TestResult result;
+    result.suite = suite.isEmpty() ? info.dir().dirName() : suite;
+    result.name = info.baseName();
+    result.filename = info.absoluteFilePath();
+    result.expectedFile = expectedFile;
+    result.passed = false;
+    result.timedOut = false;
+    result.elapsedMs = 0;
+    m_results.push_back(result);
+}
+
+void ParallelTester::addTestDirectory(QString testsDir)
+{
+    QStringList suiteDirs;
+    QDirIterator directories(testsDir, QDir::Dirs | QDir::NoSymLinks | QDir::NoDotAndDotDot);
+    while (directories.hasNext()) {
+        suiteDirs << directories.next();
+    }
+    suiteDirs.sort();
+    for (QString suiteDir: suiteDirs) {
+        QDir dir(suiteDir);
+        dir.setFilter(QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+        dir.setSorting(QDir::Name);
+        QFileInfoList list = dir.entryInfoList(QStringList() << "*.stride");
+        for (auto fileInfo : list) {
+            QString expectedName = fileInfo.absolutePath() + QDir::separator() + fileInfo.baseName() + ".expected";
+            if (QFile::exists(expectedName)) {
+                addTest(fileInfo.absoluteFilePath(), expectedName, dir.dirName());
+            }
+        }
+    }
+}
+
+bool ParallelTester::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Parsing and validation share global parser state, so do them here
+    std::vector<PreparedTest> prepared(m_results.size());
+    std::vector<bool> ready(m_results.size(), false);
+    for (size_t i = 0; i < m_results.size(); i++) {
+        ready[i] = prepare(i, prepared[i]);
+    }
+
+    QThreadPool pool;
+    if (m_maxJobs > 0) {
+        pool.setMaxThreadCount(m_maxJobs);
+    }
+    for (size_t i = 0; i < m_results.size(); i++) {
+        if (ready[i]) {
+            pool.start(new ParallelTestTask(this, i, prepared[i]));
+        }
+    }
+    pool.waitForDone();
+
+    m_totalElapsed = timer.elapsed();
+    for (auto result: m_results) {
+        std::cerr << (result.passed ? "PASS " : "FAIL ")
+                  << result.suite.toStdString() << "/" << result.name.toStdString()
+                  << " (" << result.elapsedMs << " ms)";
+        if (!result.passed) {
+            std::cerr << ": " << result.message.toStdString();
+        }
+        std::cerr << std::endl;
+    }
+    std::cerr << m_results.size() - failedCount() << "/" << m_results.size()
+              << " tests passed in " << m_totalElapsed << " ms" << std::endl;
+    return failedCount() == 0;
+}
+
+int ParallelTester::failedCount() const
+{
+    int count = 0;
+    for (auto result: m_results) {
+        if (!result.passed) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool ParallelTester::prepare(size_t index, PreparedTest &prepared)
+{
+    TestResult &result = m_results[index];
+    QElapsedTimer timer;
+    timer.start();
+
+    ASTNode tree = AST::parseFile(result.filename.toLocal8Bit().constData());
+    vector<LangError> syntaxErrors = AST::getParseErrors();
+    if (!tree || syntaxErrors.size() > 0) {
+        result.message = "Syntax error";
+        if (syntaxErrors.size() > 0) {
+            result.message += ": " + QString::fromStdString(syntaxErrors.at(0).getErrorText());
+        }
+        result.elapsedMs = timer.elapsed();
+        return false;
+    }
+
+    std::shared_ptr<StrideSystem> system = m_systems.getSystem(tree);
+    CodeValidator validator(system, tree,
+                            CodeValidator::Options(CodeValidator::USE_TESTING | CodeValidator::OPTIMIZE));
+    if (!validator.isValid()) {
+        QList<LangError> errors = validator.getErrors();
+        result.message = "Validation error: " + QString::fromStdString(errors[0].getErrorText());
+        result.elapsedMs = timer.elapsed();
+        return false;
+    }
+
+    prepared.tree = tree;
+    prepared.system = system;
+    for (string domain: CodeValidator::getUsedDomains(tree)) {
+        prepared.usedFrameworks.push_back(CodeValidator::getFrameworkForDomain(domain, tree));
+    }
+    // Each test gets its own products directory so builds don't collide
+    QString suiteDir = m_productsRoot + QDir::separator() + result.suite;
+    if (!QDir().mkpath(suiteDir)) {
+        result.message = "Can't create products directory " + suiteDir;
+        result.elapsedMs = timer.elapsed();
+        return false;
+    }
+    prepared.productsFile = suiteDir + QDir::separator() + QFileInfo(result.filename).fileName();
+    result.elapsedMs = timer.elapsed();
+    return true;
+}
+
+void ParallelTester::buildAndRun(size_t index, PreparedTest prepared)
+{
+    TestResult &result = m_results[index];
+    QElapsedTimer timer;
+    timer.start();
+
+    // Builders must be created in this thread as they own the QProcess objects
+    std::vector<Builder *> builders = prepared.system->createBuilders(prepared.productsFile,
+                                                                      prepared.usedFrameworks);
+    if (builders.size() == 0) {
+        result.message = "Can't create builder";
+        result.elapsedMs += timer.elapsed();
+        return;
+    }
+    bool passed = true;
+    for (auto builder: builders) {
+        builder->setTimeout(m_timeout);
+        QElapsedTimer stepTimer;
+        stepTimer.start();
+        if (!builder->build(prepared.tree)) {
+            result.timedOut = m_timeout > 0 && stepTimer.hasExpired(m_timeout);
+            result.message = result.timedOut ? "Build timed out" : "Build failed: " + builder->getStdErr().trimmed();
+            passed = false;
+            break;
+        }
+    }
+    if (passed) {
+        for (auto builder: builders) {
+            builder->clearBuffers();
+            QElapsedTimer stepTimer;
+            stepTimer.start();
+            if (!builder->run()) {
+                result.timedOut = m_timeout > 0 && stepTimer.hasExpired(m_timeout);
+                result.message = result.timedOut ? "Run timed out" : "Run failed: " + builder->getStdErr().trimmed();
+                passed = false;
+                break;
+            }
+            QString failedOutput = prepared.productsFile + "_Products" + QDir::separator() + "failed.output";
+            if (!BuildTester::compareOutput(builder->getStdOut(), result.expectedFile.toStdString(),
+                                            failedOutput, &result.message)) {
+                passed = false;
+                break;
+            }
+        }
+    }
+    for (auto builder: builders) {
+        delete builder;
+    }
+    result.passed = passed;
+    result.elapsedMs += timer.elapsed();
+}
+
+bool ParallelTester::writeJUnitReport(QString filename) const
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QStringList suites;
+    for (auto result: m_results) {
+        if (!suites.contains(result.suite)) {
+            suites << result.suite;
+        }
+    }
+    QXmlStreamWriter xml(&file);
+    xml.setAutoFormatting(true);
+    xml.writeStartDocument();
+    xml.writeStartElement("testsuites");
+    xml.writeAttribute("tests", QString::number(m_results.size()));
+    xml.writeAttribute("failures", QString::number(failedCount()));
+    xml.writeAttribute("time", QString::number(m_totalElapsed/1000.0));
+    for (QString suite: suites) {
+        int tests = 0, failures = 0;
+        qint64 elapsed = 0;
+        for (auto result: m_results) {
+            if (result.suite == suite) {
+                tests++;
+                failures += result.passed ? 0 : 1;
+                elapsed += result.elapsedMs;
+            }
+        }
+        xml.writeStartElement("testsuite");
+        xml.writeAttribute("name", suite);
+        xml.writeAttribute("tests", QString::number(tests));
+        xml.writeAttribute("failures", QString::number(failures));
+        xml.writeAttribute("time", QString::number(elapsed/1000.0));
+        for (auto result: m_results) {
+            if (result.suite != suite) {
+                continue;
+            }
+            xml.writeStartElement("testcase");
+            xml.writeAttribute("classname", suite);
+            xml.writeAttribute("name", result.name);
+            xml.writeAttribute("file", result.filename);
+            xml.writeAttribute("time", QString::number(result.elapsedMs/1000.0));
+            if (!result.passed) {
+                xml.writeStartElement(result.timedOut ? "error" : "failure");
+                xml.writeAttribute("message", result.message);
+                xml.writeEndElement();
+            }
+            xml.writeEndElement();
+        }
+        xml.writeEndElement();
+    }
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    return true;
+}
+
+bool ParallelTester::writeJsonReport(QString filename) const
+{
+    QJsonArray tests;
+    for (auto result: m_results) {
+        QJsonObject test;
+        test["suite"] = result.suite;
+        test["name"] = result.name;
+        test["filename"] = result.filename;
+        test["passed"] = result.passed;
+        test["timedOut"] = result.timedOut;
+        test["message"] = result.message;
+        test["elapsedMs"] = result.elapsedMs;
+        tests.append(test);
+    }
+    QJsonObject report;
+    report["tests"] = tests;
+    report["total"] = (int) m_results.size();
+    report["failed"] = failedCount();
+    report["elapsedMs"] = m_totalElapsed;
+
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(report).toJson());
+    return true;
+}
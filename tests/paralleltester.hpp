@@ -0,0 +1,104 @@
+/*
+    Stride is licensed under the terms of the 3-clause BSD license.
+
+    Copyright (C) 2017. The Regents of the University of California.
+    All rights reserved.
+    Redistribution and use in source and binary forms, with or without
+    modification, are permitted provided that the following conditions are met:
+
+        Redistributions of source code must retain the above copyright notice,
+        this list of conditions and the following disclaimer.
+
+        Redistributions in binary form must reproduce the above copyright
+        notice, this list of conditions and the following disclaimer in the
+        documentation and/or other materials provided with the distribution.
+
+        Neither the name of the copyright holder nor the names of its
+        contributors may be used to endorse or promote products derived from
+        this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+    AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+    IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+    ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+    LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+    CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+    SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+    INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+    CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+    ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+    POSSIBILITY OF SUCH DAMAGE.
+
+    Authors: Andres Cabrera and Joseph Tilbian
+*/
+
+#ifndef PARALLELTESTER_HPP
+#define PARALLELTESTER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+
+#include "ast.h"
+#include "stridesystem.hpp"
+#include "stridesystemcache.hpp"
+
+/// Builds and runs code generation tests concurrently. Parsing and validation
+/// are done serially (the parser is not reentrant) against systems that are
+/// loaded once and shared, then each test is built and run in its own thread
+/// and products directory.
+class ParallelTester
+{
+public:
+    typedef struct {
+        QString suite;
+        QString name;
+        QString filename;
+        QString expectedFile;
+        bool passed;
+        bool timedOut;
+        QString message;
+        qint64 elapsedMs;
+    } TestResult;
+
+    ParallelTester(std::string strideRoot, QString productsRoot = QString(),
+                   int maxJobs = 0, int timeoutMs = 120000);
+
+    void addTest(QString filename, QString expectedFile, QString suite = QString());
+    void addTestDirectory(QString testsDir); // Adds all .stride files with a matching .expected file in subdirectories
+
+    bool run(); // Returns true if all tests passed
+
+    std::vector<TestResult> getResults() const { return m_results; }
+    int failedCount() const;
+
+    bool writeJUnitReport(QString filename) const;
+    bool writeJsonReport(QString filename) const;
+
+private:
+    typedef struct {
+        ASTNode tree;
+        QString productsFile;
+        std::shared_ptr<StrideSystem> system;
+        std::vector<std::string> usedFrameworks;
+    } PreparedTest;
+
+    bool prepare(size_t index, PreparedTest &prepared);
+    void buildAndRun(size_t index, PreparedTest prepared);
+
+    friend class ParallelTestTask;
+
+    std::string m_strideRoot;
+    QString m_productsRoot;
+    int m_maxJobs;
+    int m_timeout;
+    std::vector<TestResult> m_results;
+    StrideSystemCache m_systems;
+    qint64 m_totalElapsed;
+};
+
+#endif // PARALLELTESTER_HPP
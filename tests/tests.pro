@@ -11,7 +11,8 @@ INCLUDEPATH += ../parser
 TEMPLATE = app
 
 SOURCES += tst_parsertest.cpp \
-    buildtester.cpp
+    buildtester.cpp \
+    paralleltester.cpp
 DEFINES += BUILDPATH=\\\"$$OUT_PWD/\\\"
 CONFIG += c++11
 
@@ -113,5 +114,6 @@ else:win32-msvc2015:CONFIG(debug, debug|release): PRE_TARGETDEPS += $$OUT_PWD/..
 else:unix: PRE_TARGETDEPS += $$OUT_PWD/../parser/libStrideParser.a
 
 HEADERS += \
-    buildtester.hpp
+    buildtester.hpp \
+    paralleltester.hpp
 
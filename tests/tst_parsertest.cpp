@@ -32,15 +32,22 @@
     Authors: Andres Cabrera and Joseph Tilbian
 */
 
+#include <cmath>
+
 #include <QString>
 #include <QtTest>
 #include <QScopedPointer>
+#include <QTemporaryDir>
 
 #include "strideparser.h"
 #include "strideplatform.hpp"
 #include "codevalidator.h"
 #include "coderesolver.h"
+#include "incrementalresolver.hpp"
+#include "stridesystemcache.hpp"
+#include "builder.h"
 #include "buildtester.hpp"
+#include "paralleltester.hpp"
 
 #define STRIDEROOT "../strideroot"
 
@@ -57,6 +64,11 @@ private:
 
     void testMultichannelUgens(); // TODO Need to complete support for this.
 
+    QStringList describeTree(ASTNode tree);
+    void describeNode(ASTNode node, std::string &description);
+    QStringList runTestingProgram(QString dataFile, QMap<QString, QVariant> configuration,
+                                  QString *mainCode = nullptr);
+
 private Q_SLOTS:
 
     // Code generation/Compiler
@@ -68,6 +80,10 @@ private Q_SLOTS:
     // Connections
     void testConnectionErrors();
     void testConnectionCount();
+    void testIncrementalResolution();
+    void testIncrementalOptimization();
+    void testIncrementalSharedModules();
+    void testLazyLibraryLoading();
 
     void testBlockMembers();
     void testModuleDomains();
@@ -91,6 +107,11 @@ private Q_SLOTS:
     void testStreamExpansion();
     void testStreamRates();
     void testConstantResolution();
+    void testPureFunctionEvaluation();
+    void testDeadCodeElimination();
+    void testCommonSubexpressionElimination();
+    void testParallelClusters();
+    void testPipeline();
 
     // Parser
     void testModules();
@@ -110,6 +131,65 @@ ParserTest::ParserTest()
     qSetMessagePattern("[%{time yyyy-MM-dd h:mm:ss.zzz}%{if-debug}D%{endif}%{if-info}I%{endif}%{if-warning}W%{endif}%{if-critical}C%{endif}%{if-fatal}F%{endif}][%{file}:%{line} %{function}] %{message}");
 }
 
+// Top level nodes described without source positions, in sorted order, as
+// the incremental resolver groups nodes that share names
+QStringList ParserTest::describeTree(ASTNode tree)
+{
+    QStringList descriptions;
+    for (ASTNode node: tree->getChildren()) {
+        std::string description;
+        describeNode(node, description);
+        descriptions << QString::fromStdString(description);
+    }
+    descriptions.sort();
+    return descriptions;
+}
+
+void ParserTest::describeNode(ASTNode node, std::string &description)
+{
+    description += std::to_string(node->getNodeType()) + ":";
+    switch (node->getNodeType()) {
+    case AST::Block:
+        description += static_cast<BlockNode *>(node.get())->getName();
+        break;
+    case AST::Bundle:
+        description += static_cast<BundleNode *>(node.get())->getName();
+        break;
+    case AST::Declaration:
+    case AST::BundleDeclaration:
+        description += static_cast<DeclarationNode *>(node.get())->getObjectType() + " "
+                + static_cast<DeclarationNode *>(node.get())->getName();
+        break;
+    case AST::Function:
+        description += static_cast<FunctionNode *>(node.get())->getName();
+        break;
+    case AST::Property:
+        description += static_cast<PropertyNode *>(node.get())->getName();
+        break;
+    case AST::PortProperty:
+        description += static_cast<PortPropertyNode *>(node.get())->getName() + "."
+                + static_cast<PortPropertyNode *>(node.get())->getPortName();
+        break;
+    case AST::Expression:
+        description += static_cast<ExpressionNode *>(node.get())->getExpressionTypeString();
+        break;
+    case AST::Int:
+    case AST::Real:
+    case AST::String:
+    case AST::Switch:
+        description += static_cast<ValueNode *>(node.get())->toString();
+        break;
+    default:
+        break;
+    }
+    description += "(";
+    for (ASTNode child: node->getChildren()) {
+        describeNode(child, description);
+        description += ",";
+    }
+    description += ")";
+}
+
 void ParserTest::testMultichannelUgens()
 {
     ASTNode tree;
@@ -153,26 +233,24 @@ void ParserTest::testPortNameValidation()
 
 void ParserTest::testCodeGeneration()
 {
-    QStringList testFiles;
-    QDirIterator directories(QFINDTESTDATA(STRIDEROOT "/frameworks/RtAudio/1.0/_tests/"), QDir::Dirs | QDir::NoSymLinks | QDir::NoDotAndDotDot);
-
-    BuildTester tester(QFINDTESTDATA(STRIDEROOT).toStdString());
-    while (directories.hasNext()) {
-        QDir dir(directories.next());
-        dir.setFilter(QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
-        dir.setSorting(QDir::Name);
-        QStringList nameFilters;
-        nameFilters << "*.stride";
-
-        QFileInfoList list = dir.entryInfoList(nameFilters);
-        for (auto fileInfo : list) {
-            qDebug() << "Testing: " << fileInfo.absoluteFilePath();
-            QString expectedName = fileInfo.absolutePath() + QDir::separator() + fileInfo.baseName() + ".expected";
-            if (QFile::exists(expectedName)) {
-                QVERIFY(tester.test(fileInfo.absoluteFilePath().toStdString(), expectedName.toStdString()));
-            }
+    // STRIDE_TEST_JOBS limits the number of concurrent builds (default: one per core)
+    // STRIDE_TEST_TIMEOUT sets the build and run timeout per test in seconds
+    int jobs = qEnvironmentVariableIntValue("STRIDE_TEST_JOBS");
+    int timeout = qEnvironmentVariableIsSet("STRIDE_TEST_TIMEOUT") ?
+                qEnvironmentVariableIntValue("STRIDE_TEST_TIMEOUT") : 120;
+
+    ParallelTester tester(QFINDTESTDATA(STRIDEROOT).toStdString(), QString(), jobs, timeout * 1000);
+    tester.addTestDirectory(QFINDTESTDATA(STRIDEROOT "/frameworks/RtAudio/1.0/_tests/"));
+    bool passed = tester.run();
+    tester.writeJUnitReport("codegen_tests.xml");
+    tester.writeJsonReport("codegen_tests.json");
+
+    for (auto result: tester.getResults()) {
+        if (!result.passed) {
+            qDebug() << "Failed: " << result.filename << result.message;
         }
-      }
+    }
+    QVERIFY(passed);
 }
 
 void ParserTest::testCompilation()
@@ -429,6 +507,145 @@ void ParserTest::testConnectionCount()
 
 }
 
+void ParserTest::testIncrementalResolution()
+{
+    StrideSystemCache systems(QFINDTESTDATA(STRIDEROOT));
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/13_connection_count.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    IncrementalResolver resolver(systems.getSystem(tree));
+    CodeValidator generator(resolver, tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator.isValid());
+    // The top level streams and the modules share no names
+    QVERIFY(resolver.resolvedGroups() == 2);
+    QVERIFY(resolver.reusedGroups() == 0);
+
+    DeclarationNode *block = static_cast<DeclarationNode *>(tree->getChildren().at(1).get());
+    QVERIFY(block->getNodeType() == AST::Declaration);
+    QVERIFY(block->getName() == "InSignal");
+    int line = block->getLine();
+    ListNode *reads = static_cast<ListNode *>(block->getPropertyValue("_reads").get());
+    QVERIFY(reads->getNodeType() == AST::List);
+    QVERIFY(reads->getChildren().size() == 2);
+
+    // Same program again. Nothing should be resolved
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/13_connection_count.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator2(resolver, tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator2.isValid());
+    QVERIFY(resolver.resolvedGroups() == 0);
+    QVERIFY(resolver.reusedGroups() == 2);
+
+    block = static_cast<DeclarationNode *>(tree->getChildren().at(1).get());
+    QVERIFY(block->getName() == "InSignal");
+    QVERIFY(block->getLine() == line);
+    reads = static_cast<ListNode *>(block->getPropertyValue("_reads").get());
+    QVERIFY(reads->getNodeType() == AST::List);
+    QVERIFY(reads->getChildren().size() == 2);
+}
+
+void ParserTest::testIncrementalOptimization()
+{
+    // Dead code and common subexpressions must be removed the same way whether
+    // the program is resolved incrementally (compile server) or not (stridecc)
+    StrideSystemCache systems(QFINDTESTDATA(STRIDEROOT));
+    CodeValidator::Options options = CodeValidator::Options(CodeValidator::NO_RATE_VALIDATION | CodeValidator::OPTIMIZE);
+    for (QString fileName: {QString("data/E07_dead_code.stride"), QString("data/E08_common_subexpressions.stride")}) {
+        ASTNode tree = AST::parseFile(QString(QFINDTESTDATA(fileName)).toStdString().c_str());
+        QVERIFY(tree != nullptr);
+        CodeValidator generator(systems.getSystem(tree), tree, options);
+        QVERIFY(generator.isValid());
+        QStringList expected = describeTree(tree);
+
+        IncrementalResolver resolver(systems.getSystem(tree));
+        for (int run = 0; run < 2; run++) { // Second run reuses the resolved groups
+            ASTNode incrementalTree = AST::parseFile(QString(QFINDTESTDATA(fileName)).toStdString().c_str());
+            QVERIFY(incrementalTree != nullptr);
+            CodeValidator incrementalGenerator(resolver, incrementalTree, options);
+            QVERIFY(incrementalGenerator.isValid());
+            QVERIFY(incrementalGenerator.getTree() != incrementalTree);
+            QCOMPARE(describeTree(incrementalGenerator.getTree()), expected);
+        }
+        QVERIFY(resolver.reusedGroups() > 0);
+    }
+}
+
+void ParserTest::testIncrementalSharedModules()
+{
+    // Each group annotates its own copy of Level. The merged declaration must
+    // hold everything that resolving the whole program at once produces
+    StrideSystemCache systems(QFINDTESTDATA(STRIDEROOT));
+    ASTNode tree = AST::parseFile(QString(QFINDTESTDATA("data/E10_shared_modules.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(systems.getSystem(tree), tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator.isValid());
+
+    ASTNode incrementalTree = AST::parseFile(QString(QFINDTESTDATA("data/E10_shared_modules.stride")).toStdString().c_str());
+    QVERIFY(incrementalTree != nullptr);
+    IncrementalResolver resolver(systems.getSystem(incrementalTree));
+    CodeValidator incrementalGenerator(resolver, incrementalTree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(incrementalGenerator.isValid());
+    QVERIFY(resolver.resolvedGroups() == 2);
+
+    auto findLevel = [](ASTNode tree) {
+        std::vector<DeclarationNode *> declarations;
+        for (ASTNode node: tree->getChildren()) {
+            if (node->getNodeType() == AST::Declaration
+                    && static_cast<DeclarationNode *>(node.get())->getName() == "Level") {
+                declarations.push_back(static_cast<DeclarationNode *>(node.get()));
+            }
+        }
+        return declarations;
+    };
+    auto declarationNames = [](DeclarationNode *module, std::string propertyName) {
+        QSet<QString> names;
+        ASTNode list = module->getPropertyValue(propertyName);
+        if (list && list->getNodeType() == AST::List) {
+            for (ASTNode child: list->getChildren()) {
+                if (child->getNodeType() == AST::Declaration) {
+                    DeclarationNode *declaration = static_cast<DeclarationNode *>(child.get());
+                    QString name = QString::fromStdString(declaration->getName());
+                    for (auto property: declaration->getProperties()) {
+                        names << name + "." + QString::fromStdString(property->getName());
+                    }
+                }
+            }
+        }
+        return names;
+    };
+    std::vector<DeclarationNode *> expected = findLevel(tree);
+    std::vector<DeclarationNode *> merged = findLevel(incrementalTree);
+    QVERIFY(expected.size() == 1);
+    QVERIFY(merged.size() == 1);
+    QSet<QString> expectedProperties, mergedProperties;
+    for (auto property: expected[0]->getProperties()) {
+        expectedProperties << QString::fromStdString(property->getName());
+    }
+    for (auto property: merged[0]->getProperties()) {
+        mergedProperties << QString::fromStdString(property->getName());
+    }
+    QVERIFY(mergedProperties.contains(expectedProperties));
+    QVERIFY(declarationNames(merged[0], "ports").contains(declarationNames(expected[0], "ports")));
+    QVERIFY(declarationNames(merged[0], "blocks").contains(declarationNames(expected[0], "blocks")));
+}
+
+void ParserTest::testLazyLibraryLoading()
+{
+    StrideSystemCache systems(QFINDTESTDATA(STRIDEROOT));
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/13_connection_count.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    std::shared_ptr<StrideSystem> system = systems.getSystem(tree);
+    CodeValidator generator(system, tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator.isValid());
+    // The program uses no library modules, so they should not have been parsed
+    int loadedFiles = system->loadedFileCount();
+    QVERIFY(loadedFiles > 0);
+    QVERIFY(!system->getFunctionNames().isEmpty()); // Loads everything
+    QVERIFY(system->loadedFileCount() > loadedFiles);
+    QVERIFY(system->getFunctionNames().contains("Level"));
+}
+
 void ParserTest::testModuleDomains()
 {
     ASTNode tree;
@@ -684,6 +901,312 @@ void ParserTest::testImport()
     QVERIFY(error.errorTokens[0] == "F::LowPass");
 }
 
+void ParserTest::testPureFunctionEvaluation()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/E06_pure_functions.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree, CodeValidator::NO_RATE_VALIDATION);
+    QVERIFY(generator.isValid());
+
+    // Angle * 2.0 >> Sin() >> A;
+    StreamNode *stream = static_cast<StreamNode *>(tree->getChildren().at(2).get());
+    QVERIFY(stream->getNodeType() == AST::Stream);
+    ValueNode *value = static_cast<ValueNode *>(stream->getLeft().get());
+    QVERIFY(value->getNodeType() == AST::Real);
+    QVERIFY(qFuzzyCompare(value->getRealValue(), std::sin(1.0)));
+    QVERIFY(stream->getRight()->getNodeType() == AST::Block);
+
+    // [2.0, 3.0] >> Pow() >> B;
+    stream = static_cast<StreamNode *>(tree->getChildren().at(3).get());
+    value = static_cast<ValueNode *>(stream->getLeft().get());
+    QVERIFY(value->getNodeType() == AST::Real);
+    QVERIFY(qFuzzyCompare(value->getRealValue(), 8.0));
+    QVERIFY(stream->getRight()->getNodeType() == AST::Block);
+
+    // 0.0 >> Cos() >> Exp() >> C;
+    stream = static_cast<StreamNode *>(tree->getChildren().at(4).get());
+    value = static_cast<ValueNode *>(stream->getLeft().get());
+    QVERIFY(value->getNodeType() == AST::Real);
+    QVERIFY(qFuzzyCompare(value->getRealValue(), std::exp(1.0)));
+    QVERIFY(stream->getRight()->getNodeType() == AST::Block);
+
+    // In >> Sin() >> D;
+    stream = static_cast<StreamNode *>(tree->getChildren().at(5).get());
+    QVERIFY(stream->getLeft()->getNodeType() == AST::Block);
+    QVERIFY(stream->getRight()->getNodeType() == AST::Stream);
+    StreamNode *right = static_cast<StreamNode *>(stream->getRight().get());
+    QVERIFY(right->getLeft()->getNodeType() == AST::Function);
+}
+
+void ParserTest::testDeadCodeElimination()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/E07_dead_code.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree,
+                            CodeValidator::Options(CodeValidator::NO_RATE_VALIDATION | CodeValidator::ELIMINATE_DEAD_CODE));
+    QVERIFY(generator.isValid());
+
+    int streamCount = 0;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            streamCount++;
+            ASTNode left = static_cast<StreamNode *>(node.get())->getLeft();
+            QVERIFY(left->getNodeType() != AST::Block
+                    || static_cast<BlockNode *>(left.get())->getName() != "Unheard");
+            ASTNode right = static_cast<StreamNode *>(node.get())->getRight();
+            QVERIFY(right->getNodeType() != AST::Block
+                    || static_cast<BlockNode *>(right.get())->getName() != "Gain");
+        }
+    }
+    QVERIFY(streamCount == 3);
+    QVERIFY(CodeValidator::findDeclaration("Heard", QVector<ASTNode>(), tree));
+    QVERIFY(!CodeValidator::findDeclaration("Unheard", QVector<ASTNode>(), tree));
+    QVERIFY(!CodeValidator::findDeclaration("AlsoUnheard", QVector<ASTNode>(), tree));
+
+    // The unused stream, its signal and the port it read are removed from the module
+    std::shared_ptr<DeclarationNode> module = CodeValidator::findDeclaration("Scale", QVector<ASTNode>(), tree);
+    QVERIFY(module);
+    QVERIFY(module->getPropertyValue("streams")->getChildren().size() == 1);
+    QVERIFY(module->getPropertyValue("ports")->getChildren().size() == 2);
+    QVector<ASTNode> blocks = QVector<ASTNode>::fromStdVector(module->getPropertyValue("blocks")->getChildren());
+    QVERIFY(!CodeValidator::findDeclaration("Unread", blocks, nullptr));
+    QVERIFY(!CodeValidator::findDeclaration("Offset", blocks, nullptr));
+
+    // AudioIn[1] >> Scale(offset: 0.25) >> AudioOut[1];
+    StreamNode *stream = nullptr;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() == AST::Stream) {
+            stream = static_cast<StreamNode *>(node.get());
+            break;
+        }
+    }
+    QVERIFY(stream->getRight()->getNodeType() == AST::Stream);
+    ASTNode function = static_cast<StreamNode *>(stream->getRight().get())->getLeft();
+    QVERIFY(function->getNodeType() == AST::Function);
+    QVERIFY(!static_cast<FunctionNode *>(function.get())->getPropertyValue("offset"));
+
+    // Unused ports are removed from the copy of Level in the tree, not from
+    // the system's own declaration, which later programs use
+    std::shared_ptr<DeclarationNode> level = CodeValidator::findDeclaration("Level", QVector<ASTNode>(), tree);
+    QVERIFY(level);
+    std::shared_ptr<DeclarationNode> builtinLevel;
+    map<string, vector<ASTNode>> objects = generator.getSystem()->getBuiltinObjectsReference();
+    for (auto it = objects.begin(); it != objects.end(); it++) {
+        for (ASTNode object: it->second) {
+            if (object->getNodeType() == AST::Declaration
+                    && static_cast<DeclarationNode *>(object.get())->getName() == "Level") {
+                builtinLevel = static_pointer_cast<DeclarationNode>(object);
+            }
+        }
+    }
+    QVERIFY(builtinLevel);
+    QVERIFY(builtinLevel != level);
+    QVERIFY(builtinLevel->getPropertyValue("ports")->getChildren().size() == 6);
+}
+
+void ParserTest::testCommonSubexpressionElimination()
+{
+    ASTNode tree;
+    tree = AST::parseFile(QString(QFINDTESTDATA("data/E08_common_subexpressions.stride")).toStdString().c_str());
+    QVERIFY(tree != nullptr);
+    CodeValidator generator(QFINDTESTDATA(STRIDEROOT), tree,
+                            CodeValidator::Options(CodeValidator::NO_RATE_VALIDATION | CodeValidator::ELIMINATE_COMMON_SUBEXPRESSIONS));
+    QVERIFY(generator.isValid());
+
+    int multiplyCount = 0, domainMultiplyCount = 0, addCount = 0, greaterCount = 0, streamCount = 0;
+    for (ASTNode node: tree->getChildren()) {
+        if (node->getNodeType() != AST::Stream) {
+            continue;
+        }
+        StreamNode *stream = static_cast<StreamNode *>(node.get());
+        if (stream->getRight()->getNodeType() == AST::Block
+                && static_cast<BlockNode *>(stream->getRight().get())->getName().find("_BridgeSig_") == 0) {
+            continue; // Carries Control into the audio domain
+        }
+        streamCount++;
+        if (stream->getLeft()->getNodeType() == AST::Expression) {
+            ExpressionNode *expr = static_cast<ExpressionNode *>(stream->getLeft().get());
+            if (expr->getExpressionType() == ExpressionNode::Multiply) {
+                ASTNode factor = expr->getRight();
+                if (factor->getNodeType() == AST::Real && static_cast<ValueNode *>(factor.get())->getRealValue() == 4.0) {
+                    domainMultiplyCount++;
+                } else {
+                    multiplyCount++;
+                }
+            } else if (expr->getExpressionType() == ExpressionNode::Add) {
+                addCount++;
+            }
+        }
+        // Shared values are only read in their own domain
+        ASTNode left = stream->getLeft();
+        ASTNode reader = stream->getRight();
+        if (reader->getNodeType() == AST::Stream) {
+            reader = static_cast<StreamNode *>(reader.get())->getLeft();
+        }
+        if (left->getNodeType() == AST::Block
+                && static_cast<BlockNode *>(left.get())->getName().find("_Common_") == 0) {
+            std::string commonDomain = CodeValidator::getNodeDomainName(left, QVector<ASTNode>(), tree);
+            std::string readerDomain = CodeValidator::getNodeDomainName(reader, QVector<ASTNode>(), tree);
+            QVERIFY(commonDomain.empty() || readerDomain.empty() || commonDomain == readerDomain);
+        }
+        if (stream->getRight()->getNodeType() == AST::Stream) {
+            ASTNode next = static_cast<StreamNode *>(stream->getRight().get())->getLeft();
+            if (next->getNodeType() == AST::Function
+                    && static_cast<FunctionNode *>(next.get())->getName() == "Greater") {
+                greaterCount++;
+            }
+        }
+    }
+    QVERIFY(streamCount == 11);
+    QVERIFY(multiplyCount == 1);
+    QVERIFY(domainMultiplyCount == 2);
+    QVERIFY(greaterCount == 1);
+    QVERIFY(addCount == 2);
+    QVERIFY(CodeValidator::findDeclaration("_Common_0", QVector<ASTNode>(), tree));
+    QVERIFY(CodeValidator::findDeclaration("_Common_1", QVector<ASTNode>(), tree));
+    QVERIFY(!CodeValidator::findDeclaration("_Common_2", QVector<ASTNode>(), tree));
+}
+
+void ParserTest::testParallelClusters()
+{
+    // Built outside the source tree, as the products are written next to the file
+    QTemporaryDir productsDir;
+    QVERIFY(productsDir.isValid());
+    QString fileName = productsDir.path() + QDir::separator() + "E09_parallel_clusters.stride";
+    QVERIFY(QFile::copy(QFINDTESTDATA("data/E09_parallel_clusters.stride"), fileName));
+    ASTNode tree = AST::parseFile(fileName.toLocal8Bit().constData());
+    QVERIFY(tree != nullptr);
+    StrideSystemCache systems(QFINDTESTDATA(STRIDEROOT));
+    std::shared_ptr<StrideSystem> system = systems.getSystem(tree);
+    CodeValidator generator(system, tree, CodeValidator::Options(CodeValidator::USE_TESTING | CodeValidator::OPTIMIZE));
+    QVERIFY(generator.isValid());
+    vector<string> frameworks;
+    for (string domain: CodeValidator::getUsedDomains(tree)) {
+        frameworks.push_back(CodeValidator::getFrameworkForDomain(domain, tree));
+    }
+    std::vector<Builder *> builders = system->createBuilders(fileName, frameworks);
+    QVERIFY(builders.size() == 1);
+    QMap<QString, QVariant> configuration;
+    configuration["Parallel"] = 4;
+    builders[0]->setConfiguration(configuration);
+    bool built = builders[0]->build(tree);
+    delete builders[0];
+    QVERIFY(built);
+
+    QFile mainFile(fileName + "_Products/RtAudio/main.cpp");
+    QVERIFY(mainFile.open(QIODevice::ReadOnly));
+    QString code = QString::fromUtf8(mainFile.readAll());
+    QStringList clusters = code.split("void stride_cluster_AudioDomain_");
+    clusters.removeFirst();
+    QVERIFY(clusters.size() >= 2); // The last stream can still run on its own
+    int printClusters = 0, firstChannelClusters = 0;
+    for (QString cluster: clusters) {
+        cluster = cluster.left(cluster.indexOf("\n}\n")); // Function body
+        if (cluster.contains("DebugPrint_") || cluster.contains("STRIDE_DEBUG_PRINT")) {
+            printClusters++;
+        }
+        if (cluster.contains("out[0] =")) {
+            firstChannelClusters++;
+        }
+    }
+    QVERIFY(printClusters == 1);
+    QVERIFY(firstChannelClusters == 1);
+}
+
+// Builds a test data file with the testing platform and runs it. Returns the
+// printed output, one value per line, or an empty list if it fails.
+QStringList ParserTest::runTestingProgram(QString dataFile, QMap<QString, QVariant> configuration,
+                                          QString *mainCode)
+{
+    QTemporaryDir productsDir;
+    QString fileName = productsDir.path() + QDir::separator() + QFileInfo(dataFile).fileName();
+    if (!productsDir.isValid() || !QFile::copy(QFINDTESTDATA(dataFile), fileName)) {
+        return QStringList();
+    }
+    ASTNode tree = AST::parseFile(fileName.toLocal8Bit().constData());
+    if (!tree) {
+        return QStringList();
+    }
+    StrideSystemCache systems(QFINDTESTDATA(STRIDEROOT));
+    std::shared_ptr<StrideSystem> system = systems.getSystem(tree);
+    CodeValidator generator(system, tree, CodeValidator::Options(CodeValidator::USE_TESTING | CodeValidator::OPTIMIZE));
+    if (!generator.isValid()) {
+        return QStringList();
+    }
+    vector<string> frameworks;
+    for (string domain: CodeValidator::getUsedDomains(tree)) {
+        frameworks.push_back(CodeValidator::getFrameworkForDomain(domain, tree));
+    }
+    std::vector<Builder *> builders = system->createBuilders(fileName, frameworks);
+    if (builders.size() != 1) {
+        for (auto builder: builders) {
+            delete builder;
+        }
+        return QStringList();
+    }
+    builders[0]->setConfiguration(configuration);
+    bool ran = builders[0]->build(tree);
+    if (ran) {
+        builders[0]->clearBuffers();
+        ran = builders[0]->run();
+    }
+    QStringList lines = builders[0]->getStdOut().split("\n");
+    delete builders[0];
+    if (!ran) {
+        return QStringList();
+    }
+    if (mainCode) {
+        QFile mainFile(fileName + "_Products/RtAudio/main.cpp");
+        if (mainFile.open(QIODevice::ReadOnly)) {
+            *mainCode = QString::fromUtf8(mainFile.readAll());
+        }
+    }
+    // Remove the text printed by build.py when the program is run through it
+    for (int i = 0; i < lines.size(); i++) {
+        if (lines.at(i).startsWith("Running in directory:")) {
+            lines = lines.mid(i + 1);
+            break;
+        }
+    }
+    return lines;
+}
+
+void ParserTest::testPipeline()
+{
+    // Output of a pipelined program is the serial output, delayed by one
+    // block (the default 512 frames) for each stage after the first
+    const int blockSize = 512, outChannels = 2;
+    QStringList serial = runTestingProgram("data/E11_pipeline.stride", QMap<QString, QVariant>());
+    QVERIFY(serial.size() > 44100);
+    for (int stages = 2; stages <= 3; stages++) {
+        QMap<QString, QVariant> configuration;
+        configuration["Pipeline"] = stages;
+        QString code;
+        QStringList pipelined = runTestingProgram("data/E11_pipeline.stride", configuration, &code);
+        QVERIFY(pipelined.size() == serial.size());
+        // All the stages were made
+        QVERIFY(code.contains(QString("void stride_stage_AudioDomain_%1(").arg(stages - 1)));
+        QVERIFY(!code.contains(QString("void stride_stage_AudioDomain_%1(").arg(stages)));
+
+        int shift = (stages - 1) * blockSize * outChannels; // Lines, as channels are interleaved
+        int nonZero = 0;
+        for (int i = 0; i < 44100; i++) {
+            double expected = i < shift ? 0.0 : serial.at(i - shift).toDouble();
+            double out = pipelined.at(i).toDouble();
+            if (!(std::fabs(out - expected) < 0.000002)) {
+                QFAIL(QString("%1 stages: line %2 is %3, expected %4")
+                      .arg(stages).arg(i + 1).arg(out).arg(expected).toLocal8Bit().constData());
+            }
+            if (i >= shift && expected != 0.0) {
+                nonZero++;
+            }
+        }
+        QVERIFY(nonZero > 0);
+    }
+}
+
 void ParserTest::testConstantResolution()
 {
     ASTNode tree;